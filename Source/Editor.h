@@ -17,6 +17,7 @@
 #include "gui/LowLevel.h"
 
 #include "gui/Tooltip.h"
+#include "gui/ProfilerPanel.h"
 
 #include <juce_gui_basics/juce_gui_basics.h>
 #include <juce_core/juce_core.h>
@@ -54,6 +55,9 @@ namespace gui
             contextMenuButtons(utils),
 
             editorKnobs(utils),
+#if PPDHasProfiler
+            profilerPanel(utils),
+#endif
 
             bypassed(false),
             shadr(utils, *this)
@@ -83,6 +87,9 @@ namespace gui
             addAndMakeVisible(contextMenuButtons);
 
             addChildComponent(editorKnobs);
+#if PPDHasProfiler
+            addChildComponent(profilerPanel);
+#endif
             
             setOpaque(true);
             setResizable(true, true);
@@ -123,6 +130,9 @@ namespace gui
 
             const auto thicc = utils.thicc;
             editorKnobs.setBounds(0, 0, static_cast<int>(thicc * 42.f), static_cast<int>(thicc * 12.f));
+#if PPDHasProfiler
+            profilerPanel.setBounds(lowLevel.getBounds());
+#endif
 
             saveBounds();
         }
@@ -144,6 +154,13 @@ namespace gui
         }
         void mouseWheelMove(const Mouse&, const MouseWheel&) override
         {}
+        /* double click on an empty spot shows the dsp profiler */
+        void mouseDoubleClick(const Mouse&) override
+        {
+#if PPDHasProfiler
+            profilerPanel.setVisible(!profilerPanel.isVisible());
+#endif
+        }
 
         
 
@@ -164,6 +181,9 @@ protected:
         ContextMenuButtons contextMenuButtons;
 
         TextEditorKnobs editorKnobs;
+#if PPDHasProfiler
+        ProfilerPanel profilerPanel;
+#endif
 
         bool bypassed;
         Shader shadr;
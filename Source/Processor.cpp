@@ -19,17 +19,19 @@ audio::ProcessorBackEnd::ProcessorBackEnd() :
         .withOutput("Output", ChannelSet::stereo(), true)
     ),
     props(),
-    sus(*this),
     state(),
     params(*this, state),
     macroProcessor(params)
 #if PPDHasMIDILearn
     ,midiLearn(params, state)
 #endif
-#if PPDHasHQ
-    ,oversampler()
-#endif
+    ,automation(params)
+    ,modMatrix(state)
+    ,engines()
     ,meters()
+#if PPDHasProfiler
+    ,profiler()
+#endif
 #if PPDHasStereoConfig
     ,midSideEnabled(false)
 #endif
@@ -48,6 +50,7 @@ audio::ProcessorBackEnd::ProcessorBackEnd() :
 
         props.setStorageParameters(options);
     }
+    params.loadDefaults(props);
 
     startTimerHz(6);
 }
@@ -79,10 +82,11 @@ audio::ProcessorBackEnd::AppProps* audio::ProcessorBackEnd::getProps() noexcept
 
 void audio::ProcessorBackEnd::savePatch()
 {
-    params.savePatch(props);
+    params.savePatch();
 #if PPDHasMIDILearn
     midiLearn.savePatch();
 #endif
+    modMatrix.savePatch();
 }
 
 void audio::ProcessorBackEnd::loadPatch()
@@ -91,7 +95,7 @@ void audio::ProcessorBackEnd::loadPatch()
 #if PPDHasMIDILearn
     midiLearn.loadPatch();
 #endif
-    forcePrepareToPlay();
+    modMatrix.loadPatch();
 }
 
 bool audio::ProcessorBackEnd::hasEditor() const { return PPDHasEditor; }
@@ -103,35 +107,102 @@ bool audio::ProcessorBackEnd::isMidiEffect() const { return false; }
     /////////////////////////////////////////////;
 void audio::ProcessorBackEnd::getStateInformation(juce::MemoryBlock& destData)
 {
-    savePatch();
-    state.savePatch(*this, destData);
+#if PPDHasMIDILearn
+    midiLearn.savePatch();
+#endif
+    modMatrix.savePatch();
+
+    juce::MemoryOutputStream stream(destData, false);
+    stream.writeInt(StateMagic);
+    stream.writeInt(StateVersion);
+    params.savePatch(stream);
+    /* the params are in the binary part already */
+    state.savePatch(stream, "params");
 }
 
 void audio::ProcessorBackEnd::setStateInformation(const void* data, int sizeInBytes)
 {
-    state.loadPatch(*this, data, sizeInBytes);
-    loadPatch();
+    juce::MemoryInputStream stream(data, static_cast<size_t>(sizeInBytes), false);
+    if (sizeInBytes < static_cast<int>(2 * sizeof(int)) || stream.readInt() != StateMagic)
+    {
+        state.loadPatch(*this, data, sizeInBytes);
+        loadPatch();
+        return;
+    }
+
+    const auto version = stream.readInt();
+    if (version < 1 || version > StateVersion)
+    {
+        /* from a newer version of the plugin. better keep the current state */
+        DBG("unknown state version: " << version);
+        return;
+    }
+
+    /* nothing gets applied before the whole state got read */
+    Params::Patch patch;
+    juce::ValueTree tree;
+    if (!Params::readPatch(stream, patch) || !state.readPatch(stream, tree))
+    {
+        DBG("broken state");
+        return;
+    }
+    state.loadPatch(std::move(tree));
+    params.loadPatch(patch);
+#if PPDHasMIDILearn
+    midiLearn.loadPatch();
+#endif
+    modMatrix.loadPatch();
 }
 
 void audio::ProcessorBackEnd::forcePrepareToPlay()
 {
-    sus.suspend();
+    prepareEngine(getSampleRate(), getBlockSize());
+}
+
+int audio::ProcessorBackEnd::prepareEngine(double sampleRate, int blockSize)
+{
+    const auto ovsrOrder = getOversamplingOrder();
+    auto engine = std::make_unique<Engine>();
+    engine->prepare(sampleRate, blockSize, ovsrOrder);
+    const auto latency = engine->latency;
+    engines.publish(std::move(engine));
+    return latency;
+}
+
+int audio::ProcessorBackEnd::getOversamplingOrder() const noexcept
+{
+#if PPDHasHQ
+    if (params[PID::HQ]->getValMod() > .5f)
+        return static_cast<int>(std::rint(params[PID::HQFactor]->getValModDenorm()));
+#endif
+    return 0;
 }
 
 void audio::ProcessorBackEnd::timerCallback()
 {
+    engines.collect();
+    params.saveDefaults(props);
 #if PPDHasHQ
-    const auto ovsrEnabled = params[PID::HQ]->getValMod() > .5f;
-    if (oversampler.isEnabled() != ovsrEnabled)
-        forcePrepareToPlay();
+    auto& hqSwitch = engines.getLatest().hqSwitch;
+    const auto ovsrOrder = getOversamplingOrder();
+    if (hqSwitch.shallPrepare(ovsrOrder))
+    {
+        const auto pathIdx = hqSwitch.beginPreparing(ovsrOrder);
+        engines.getLatest().prepareWetPath(pathIdx);
+        hqSwitch.finishPreparing();
+    }
 #endif
 }
 
 void audio::ProcessorBackEnd::processBlockBypassed(AudioBuffer& buffer, juce::MidiBuffer&)
 {
     macroProcessor();
-    if (sus.suspendIfNeeded(buffer))
-        return;
+    processBypass(engines.acquire(), buffer);
+}
+
+void audio::ProcessorBackEnd::processBypass(Engine& engine, AudioBuffer& buffer) noexcept
+{
+    auto& dryWetMix = engine.dryWetMix;
     const auto numSamples = buffer.getNumSamples();
     if (numSamples == 0)
         return;
@@ -147,21 +218,33 @@ void audio::ProcessorBackEnd::processBlockBypassed(AudioBuffer& buffer, juce::Mi
     meters.processOut(constSamples, numChannels, numSamples);
 }
 
-audio::AudioBuffer* audio::ProcessorBackEnd::processBlockStart(AudioBuffer& buffer, juce::MidiBuffer& midi) noexcept
+int audio::ProcessorBackEnd::beginSubBlock(const juce::MidiBuffer& midi, int start, int numSamples) noexcept
 {
+    PGProfileScope(MIDI);
+    const auto end = automation(midi, start, numSamples);
+    /* the last sub-block also takes the events of empty blocks */
+    const auto midiEnd = end == numSamples ? std::numeric_limits<int>::max() : end;
 #if PPDHasMIDILearn
-    midiLearn(midi);
+    midiLearn(midi, start, midiEnd);
 #endif
+    modMatrix.processMIDI(midi, start, midiEnd);
 
     macroProcessor();
+    return end;
+}
 
+audio::AudioBuffer* audio::ProcessorBackEnd::processBlockStart(Engine& engine, AudioBuffer& buffer) noexcept
+{
     const auto numSamples = buffer.getNumSamples();
     if (numSamples == 0)
        return nullptr;
 
-    if (params[PID::Power]->getValMod() < .5f)
+    auto& dryWetMix = engine.dryWetMix;
+    const auto& snap = macroProcessor.getSnapshot();
+
+    if (snap.getValMod(PID::Power) < .5f)
     {
-        processBlockBypassed(buffer, midi);
+        processBypass(engine, buffer);
         return nullptr;
     }
 
@@ -169,136 +252,242 @@ audio::AudioBuffer* audio::ProcessorBackEnd::processBlockStart(AudioBuffer& buff
 
     auto samples = buffer.getArrayOfWritePointers();
 
+    PGProfileScope(DrySave);
     dryWetMix.saveDry(
         samples,
         numChannels,
         numSamples,
 #if PPDHasGainIn
-        const auto constSamples = buffer.getArrayOfReadPointers();
+        meters,
         params[PID::GainIn]->getValueDenorm(),
 #endif
-        params[PID::Mix]->getValMod(),
-        params[PID::Gain]->getValModDenorm()
+        snap.getValMod(PID::Mix),
+        snap.getValModDenorm(PID::Gain)
 #if PPDHasPolarity
-        , (params[PID::Polarity]->getValMod() > .5f ? -1.f : 1.f)
+        , (snap.getValMod(PID::Polarity) > .5f ? -1.f : 1.f)
 #endif
 #if PPDHasUnityGain
         , params[PID::UnityGain]->getValue()
 #endif
     );
-#if PPDHasGainIn
-    meters.processIn(constSamples, numChannels, numSamples);
-#endif
 #if PPDHasStereoConfig
-    midSideEnabled = numChannels == 2 && params[PID::StereoConfig]->getValMod() > .5f;
+    midSideEnabled = numChannels == 2 && snap.getValMod(PID::StereoConfig) > .5f;
     if (midSideEnabled)
-    {
         encodeMS(samples, numSamples);
-        {
-#if PPDHasHQ
-            return &oversampler.upsample(buffer);
-#else
-            return &buffer;
-#endif
-        }
-    }
-    else
-#endif
-    {
-#if PPDHasHQ
-        return &oversampler.upsample(buffer);
-#else
-        return &buffer;
 #endif
-    }
+    return &buffer;
 }
 
-void audio::ProcessorBackEnd::processBlockEnd(AudioBuffer& buffer) noexcept
+void audio::ProcessorBackEnd::processBlockEnd(Engine& engine, AudioBuffer& buffer) noexcept
 {
-#if PPDHasHQ
-    oversampler.downsample(buffer);
-#endif
     const auto samples = buffer.getArrayOfWritePointers();
-    const auto constSamples = buffer.getArrayOfReadPointers();
     const auto numChannels = buffer.getNumChannels();
     const auto numSamples = buffer.getNumSamples();
+    auto& dryWetMix = engine.dryWetMix;
 
+    PGProfileScope(Output);
 #if PPDHasStereoConfig
-    if (midSideEnabled)
-        decodeMS(samples, numSamples);
+    dryWetMix.processOut(samples, numChannels, numSamples, meters, midSideEnabled);
+#else
+    dryWetMix.processOut(samples, numChannels, numSamples, meters, false);
 #endif
+}
 
-    dryWetMix.processOutGain(samples, numChannels, numSamples);
-    meters.processOut(constSamples, numChannels, numSamples);
-    dryWetMix.processMix(samples, numChannels, numSamples);
+audio::Engine::Engine() :
+    dryWetMix(),
+#if PPDHasHQ
+    hqSwitch(),
+#endif
+    pitchShifters(),
+    modulations(),
+    sleep(),
+    latency(0)
+{
 }
 
-audio::Processor::Processor() :
-    ProcessorBackEnd(),
-    pitchShifter()
+void audio::Engine::prepare(double sampleRate, int blockSize, int ovsrOrder)
 {
+    latency = 0;
+#if PPDHasHQ
+    latency = hqSwitch.prepare(sampleRate, blockSize, ovsrOrder);
+    prepareWetPath(hqSwitch.getActive());
+#else
+    pitchShifters[0].prepare(static_cast<float>(sampleRate), blockSize);
+    modulations[0].prepare(static_cast<float>(sampleRate), blockSize);
+#endif
+    dryWetMix.prepare(static_cast<float>(sampleRate), blockSize, latency);
+    sleep.prepare(static_cast<float>(sampleRate), latency);
 }
 
-void audio::Processor::prepareToPlay(double sampleRate, int maxBlockSize)
+void audio::Engine::prepareWetPath(int pathIdx)
 {
-    auto latency = 0;
 #if PPDHasHQ
-    oversampler.setEnabled(params[PID::HQ]->getValMod() > .5f);
-    oversampler.prepare(sampleRate, maxBlockSize);
-    const auto sampleRateUp = oversampler.getFsUp();
-    const auto sampleRateUpF = static_cast<float>(sampleRateUp);
-    const auto blockSizeUp = oversampler.getBlockSizeUp();
-    latency = oversampler.getLatency();
+    const auto sampleRateUp = static_cast<float>(hqSwitch.getFsUp(pathIdx));
+    pitchShifters[pathIdx].prepare(sampleRateUp, hqSwitch.getBlockSizeUp(pathIdx));
+    modulations[pathIdx].prepare(sampleRateUp, hqSwitch.getBlockSizeUp(pathIdx));
+#else
+    juce::ignoreUnused(pathIdx);
 #endif
-    const auto sampleRateF = static_cast<float>(sampleRate);
+}
+
+audio::Processor::Processor() :
+    ProcessorBackEnd()
+{
+}
 
-    dryWetMix.prepare(sampleRateF, maxBlockSize, latency);
+double audio::Processor::getTailLengthSeconds() const
+{
+    static constexpr double MinusSixtyDb = .001;
+    const auto grainSecs = static_cast<double>(params[PID::GrainSize]->getValModDenorm()) * .001;
+    /* the mod matrix can push the feedback up to the sum of its depths */
+    auto fb = static_cast<double>(params[PID::Feedback]->getValModDenorm());
+    for (auto s = 0; s < ModMatrix::NumSources; ++s)
+        fb += std::abs(static_cast<double>(modMatrix.getDepth(static_cast<ModMatrix::Source>(s), ModMatrix::Dest::Feedback)))
+            * static_cast<double>(ModMatrix::MaxDepth[static_cast<int>(ModMatrix::Dest::Feedback)]);
+    const auto Fs = getSampleRate();
+    const auto latencySecs = Fs > 0. ? static_cast<double>(getLatencySamples()) / Fs : 0.;
+
+    /* every grain-long trip through the delay attenuates the tail by fb */
+    auto numTrips = 0.;
+    if (fb >= .999)
+        return std::numeric_limits<double>::infinity();
+    if (fb > MinusSixtyDb)
+        numTrips = std::log(MinusSixtyDb) / std::log(fb);
+
+    return grainSecs * (1. + numTrips) + latencySecs;
+}
 
-    meters.prepare(sampleRateF, maxBlockSize);
+void audio::Processor::prepareToPlay(double sampleRate, int maxBlockSize)
+{
+    const auto latency = prepareEngine(sampleRate, maxBlockSize);
 
-    {
-        pitchShifter.prepare(sampleRateUpF, blockSizeUp);
-    }
+    automation.prepare();
+    meters.prepare(static_cast<float>(sampleRate), maxBlockSize);
+#if PPDHasProfiler
+    profiler.prepare(sampleRate);
+#endif
 
     setLatencySamples(latency);
-
-    sus.prepareToPlay();
 }
 
 void audio::Processor::processBlock(AudioBuffer& buffer, juce::MidiBuffer& midi)
 {
     const juce::ScopedNoDenormals noDenormals;
+    const auto numSamples = buffer.getNumSamples();
+    const auto numChannels = buffer.getNumChannels();
+    const auto samples = buffer.getArrayOfWritePointers();
+#if PPDHasProfiler
+    profiler.beginBlock(numSamples);
+#endif
 
-    if (sus.suspendIfNeeded(buffer))
-        return;
+    auto& engine = engines.acquire();
 
-    auto buf = processBlockStart(buffer, midi);
+    /* runs once for empty blocks, so their midi still gets processed */
+    auto start = 0;
+    do
+    {
+        const auto end = beginSubBlock(midi, start, numSamples);
+        AudioBuffer subBuffer(samples, numChannels, start, end - start);
+        processSubBlock(engine, subBuffer);
+        start = end;
+    } while (start < numSamples);
+
+    automation.advance(numSamples);
+#if PPDHasProfiler
+    profiler.endBlock();
+#endif
+}
+
+void audio::Processor::processSubBlock(Engine& engine, AudioBuffer& buffer) noexcept
+{
+    auto buf = processBlockStart(engine, buffer);
     if (buf == nullptr)
         return;
 
-    processBlockCustom(
-        buf->getArrayOfWritePointers(),
+    const auto& snap = macroProcessor.getSnapshot();
+    const auto grainSize = snap.getValModDenorm(PID::GrainSize);
+    auto& sleep = engine.sleep;
+    if (sleep(buf->getArrayOfReadPointers(), buf->getNumChannels(), buf->getNumSamples()))
+    {
+        buf->clear();
+        processBlockEnd(engine, buffer);
+        return;
+    }
+    if (sleep.wokeUp())
+        for (auto& pitchShifter : engine.pitchShifters)
+            pitchShifter.reset();
+
+#if PPDHasHQ
+    auto& hqSwitch = engine.hqSwitch;
+    hqSwitch.setWarmUpMs(grainSize);
+    const auto numPaths = hqSwitch.getNumPaths();
+    for (auto p = 0; p < numPaths; ++p)
+    {
+        AudioBuffer* bufUp;
+        {
+            PGProfileScope(Upsample);
+            bufUp = &hqSwitch.upsample(p, *buf);
+        }
+        {
+            PGProfileScope(Voices);
+            processBlockCustom(
+                engine,
+                bufUp->getArrayOfWritePointers(),
+                bufUp->getNumChannels(),
+                bufUp->getNumSamples(),
+                hqSwitch.getPathIdx(p)
+            );
+        }
+        PGProfileScope(Downsample);
+        hqSwitch.downsample(p, *buf);
+    }
+    {
+        PGProfileScope(Downsample);
+        hqSwitch(*buf);
+    }
+#else
+    {
+        PGProfileScope(Voices);
+        processBlockCustom(
+            engine,
+            buf->getArrayOfWritePointers(),
+            buf->getNumChannels(),
+            buf->getNumSamples(),
+            0
+        );
+    }
+#endif
+
+    sleep.processTail(
+        buf->getArrayOfReadPointers(),
         buf->getNumChannels(),
-        buf->getNumSamples()
+        buf->getNumSamples(),
+        2.f * grainSize
     );
 
-    processBlockEnd(buffer);
+    processBlockEnd(engine, buffer);
 }
 
-void audio::Processor::processBlockCustom(float** samples, int numChannels, int numSamples) noexcept
+void audio::Processor::processBlockCustom(Engine& engine, float** samples, int numChannels, int numSamples, int pathIdx) noexcept
 {
-    const auto grainSize = params[PID::GrainSize]->getValModDenorm();
-    const auto tuneSemi = std::rint(params[PID::TuneSemi]->getValModDenorm());
-    const auto tuneFine = params[PID::TuneFine]->getValModDenorm();
-    const auto fb = params[PID::Feedback]->getValModDenorm();
-    const auto numVoices = static_cast<int>(std::rint(params[PID::NumVoices]->getValModDenorm()));
-    const auto spreadTune = params[PID::SpreadTune]->getValModDenorm();
+    const auto& snap = macroProcessor.getSnapshot();
+    const auto grainSize = snap.getValModDenorm(PID::GrainSize);
+    const auto tuneSemi = std::rint(snap.getValModDenorm(PID::TuneSemi));
+    const auto tuneFine = snap.getValModDenorm(PID::TuneFine);
+    const auto fb = snap.getValModDenorm(PID::Feedback);
+    const auto numVoices = static_cast<int>(std::rint(snap.getValModDenorm(PID::NumVoices)));
+    const auto spreadTune = snap.getValModDenorm(PID::SpreadTune);
 
     const auto tune = tuneSemi + tuneFine;
 
-    pitchShifter(
+    const auto mod = engine.modulations[pathIdx](
+        modMatrix, samples, numChannels, numSamples,
+        snap.getValMod(PID::Macro)
+    );
+
+    engine.pitchShifters[pathIdx](
         samples, numChannels, numSamples,
-        tune, grainSize, fb, numVoices, spreadTune
+        tune, grainSize, fb, numVoices, spreadTune, mod
     );
 }
 
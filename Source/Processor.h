@@ -15,6 +15,7 @@ namespace audio
     using AudioBuffer = juce::AudioBuffer<float>;
     using SIMD = juce::FloatVectorOperations;
     using Smooth = smooth::Smooth<float>;
+    using Ramp = smooth::Ramp<float>;
 
     using PID = param::PID;
     using Params = param::Params;
@@ -28,16 +29,22 @@ namespace audio
 }
 
 #include "audio/MIDILearn.h"
-#include "audio/ProcessSuspend.h"
+#include "audio/Automation.h"
+#include "audio/EngineSwap.h"
 #include "audio/DryWetMix.h"
 #include "audio/MidSide.h"
 #include "audio/Oversampling.h"
+#include "audio/LatencyCompensation.h"
+#include "audio/HQSwitch.h"
 #include "audio/Meter.h"
+#include "audio/Profiler.h"
+#include "audio/ProcessSleep.h"
 #include "audio/Rectifier.h"
 #include "audio/Bitcrusher.h"
 #include "audio/NullNoiseSynth.h"
 #include "audio/Phasor.h"
 #include "audio/PitchShifter.h"
+#include "audio/ModMatrix.h"
 
 #include "config.h"
 
@@ -46,6 +53,26 @@ namespace audio
     using MacroProcessor = param::MacroProcessor;
     using Timer = juce::Timer;
 
+    /* everything the dsp needs to be prepared for. gets built off the audio thread */
+    struct Engine
+    {
+        Engine();
+
+        void prepare(double /*sampleRate*/, int /*blockSize*/, int /*ovsrOrder*/);
+
+        /* prepares the wet path of this index for the current oversampling order */
+        void prepareWetPath(int /*pathIdx*/);
+
+        DryWetMix dryWetMix;
+#if PPDHasHQ
+        HQSwitch hqSwitch;
+#endif
+        std::array<GranularPitchShifter, 2> pitchShifters;
+        std::array<Modulation, 2> modulations;
+        ProcessSleep sleep;
+        int latency;
+    };
+
     struct ProcessorBackEnd :
         public juce::AudioProcessor,
         public Timer
@@ -75,11 +102,15 @@ namespace audio
 
         /////////////////////////////////////////////
         /////////////////////////////////////////////
+        /* binary state: magic, version, params, rest of the state tree.
+        sessions saved as xml are still understood */
+        static constexpr int StateMagic = 0x42445050; // "PPDB"
+        static constexpr int StateVersion = 1;
+
         void getStateInformation(juce::MemoryBlock&) override;
         void setStateInformation(const void* /*data*/, int /*sizeInBytes*/) override;
 
         AppProps props;
-        ProcessSuspender sus;
 
         State state;
         Params params;
@@ -87,13 +118,16 @@ namespace audio
 #if PPDHasMIDILearn
         MIDILearn midiLearn;
 #endif
+        Automation automation;
+        ModMatrix modMatrix;
 
-        DryWetMix dryWetMix;
-#if PPDHasHQ
-        Oversampler oversampler;
-#endif
+        EngineSwap<Engine> engines;
         Meters meters;
+#if PPDHasProfiler
+        Profiler profiler;
+#endif
 
+        /* builds and publishes a new engine. never call this from the audio thread */
         void forcePrepareToPlay();
 
         void timerCallback() override;
@@ -101,9 +135,21 @@ namespace audio
         void processBlockBypassed(AudioBuffer&, juce::MidiBuffer&) override;
 
     protected:
-        AudioBuffer* processBlockStart(AudioBuffer&, juce::MidiBuffer&) noexcept;
+        /* returns the latency of the new engine */
+        int prepareEngine(double /*sampleRate*/, int /*blockSize*/);
+
+        /* 0 if hq is off */
+        int getOversamplingOrder() const noexcept;
+
+        /* applies the parameter changes due at start. returns the end of the sub-block */
+        int beginSubBlock(const juce::MidiBuffer&, int /*start*/, int /*numSamples*/) noexcept;
 
-        void processBlockEnd(AudioBuffer&) noexcept;
+        /* the engine is acquired once per host block, so it can't change between its sub-blocks */
+        AudioBuffer* processBlockStart(Engine&, AudioBuffer&) noexcept;
+
+        void processBlockEnd(Engine&, AudioBuffer&) noexcept;
+
+        void processBypass(Engine&, AudioBuffer&) noexcept;
     
 private:
 #if PPDHasStereoConfig
@@ -118,11 +164,17 @@ private:
     {
         Processor();
 
+        /* the time it takes the feedback to decay by 60db */
+        double getTailLengthSeconds() const override;
+
         void prepareToPlay(double, int) override;
 
+        /* splits the block at parameter changes */
         void processBlock(AudioBuffer&, juce::MidiBuffer&);
+
+        void processSubBlock(Engine&, AudioBuffer&) noexcept;
         
-        void processBlockCustom(float** /*samples*/ , int /*numChannels*/, int /*numSamples*/) noexcept;
+        void processBlockCustom(Engine&, float** /*samples*/ , int /*numChannels*/, int /*numSamples*/, int /*pathIdx*/) noexcept;
 
         void releaseResources() override;
 
@@ -132,7 +184,6 @@ private:
 
         juce::AudioProcessorEditor* createEditor() override;
 
-        GranularPitchShifter pitchShifter;
     };
 }
 
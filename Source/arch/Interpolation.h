@@ -26,6 +26,20 @@ namespace interpolate
 		return a + x * (b - a);
 	}
 
+	/* samples[idx + 1] must be readable, like in a mirrored ring buffer */
+	template<typename T>
+	inline T lerp(const T* samples, T idx) noexcept
+	{
+		const auto iFloor = std::floor(idx);
+		const auto x = idx - iFloor;
+
+		const auto iF = static_cast<int>(iFloor);
+		const auto a = samples[iF];
+		const auto b = samples[iF + 1];
+
+		return a + x * (b - a);
+	}
+
 	template<typename T>
 	inline T cubicHermiteSpline(const T* buffer, T readHead, int size) noexcept
 	{
@@ -0,0 +1,172 @@
+#pragma once
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define PGSIMDAVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PGSIMDSSE 1
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define PGSIMDNEON 1
+#endif
+
+namespace vec
+{
+	/*
+	a thin wrapper around the widest float register available at compile time.
+	it only offers what the dsp code needs. every arithmetic operation is a
+	single instruction with ieee semantics, so vector and scalar code paths
+	produce identical results if they do the same operations.
+	without a gather instruction, gather loads the lanes one by one.
+	*/
+
+#if PGSIMDAVX
+	static constexpr int Width = 8;
+	using Vec = __m256;
+	using Mask = __m256;
+	using Int = __m256i;
+
+	inline Vec load(const float* x) noexcept { return _mm256_loadu_ps(x); }
+	inline void store(float* y, Vec x) noexcept { _mm256_storeu_ps(y, x); }
+	inline Vec set(float x) noexcept { return _mm256_set1_ps(x); }
+
+	inline Vec add(Vec a, Vec b) noexcept { return _mm256_add_ps(a, b); }
+	inline Vec sub(Vec a, Vec b) noexcept { return _mm256_sub_ps(a, b); }
+	inline Vec mul(Vec a, Vec b) noexcept { return _mm256_mul_ps(a, b); }
+	inline Vec div(Vec a, Vec b) noexcept { return _mm256_div_ps(a, b); }
+	inline Vec max(Vec a, Vec b) noexcept { return _mm256_max_ps(a, b); }
+
+	inline Mask lessThan(Vec a, Vec b) noexcept { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+	inline Mask greaterEqual(Vec a, Vec b) noexcept { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+	inline Mask notEqual(Vec a, Vec b) noexcept { return _mm256_cmp_ps(a, b, _CMP_NEQ_UQ); }
+	/* mask ? x : 0 */
+	inline Vec mask(Mask m, Vec x) noexcept { return _mm256_and_ps(m, x); }
+	/* mask ? a : b */
+	inline Vec select(Mask m, Vec a, Vec b) noexcept { return _mm256_blendv_ps(b, a, m); }
+
+	inline float sum(Vec x) noexcept
+	{
+		const auto lo = _mm256_castps256_ps128(x);
+		const auto hi = _mm256_extractf128_ps(x, 1);
+		auto s = _mm_add_ps(lo, hi);
+		s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+		s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+		return _mm_cvtss_f32(s);
+	}
+
+	inline Int truncate(Vec x) noexcept { return _mm256_cvttps_epi32(x); }
+	inline Vec toFloat(Int i) noexcept { return _mm256_cvtepi32_ps(i); }
+#if defined(__AVX2__)
+	inline Vec gather(const float* base, Int idx) noexcept { return _mm256_i32gather_ps(base, idx, 4); }
+#else
+	inline Vec gather(const float* base, Int idx) noexcept
+	{
+		alignas(32) int i[Width];
+		_mm256_store_si256(reinterpret_cast<__m256i*>(i), idx);
+		return _mm256_setr_ps(base[i[0]], base[i[1]], base[i[2]], base[i[3]], base[i[4]], base[i[5]], base[i[6]], base[i[7]]);
+	}
+#endif
+#elif PGSIMDSSE
+	static constexpr int Width = 4;
+	using Vec = __m128;
+	using Mask = __m128;
+	using Int = __m128i;
+
+	inline Vec load(const float* x) noexcept { return _mm_loadu_ps(x); }
+	inline void store(float* y, Vec x) noexcept { _mm_storeu_ps(y, x); }
+	inline Vec set(float x) noexcept { return _mm_set1_ps(x); }
+
+	inline Vec add(Vec a, Vec b) noexcept { return _mm_add_ps(a, b); }
+	inline Vec sub(Vec a, Vec b) noexcept { return _mm_sub_ps(a, b); }
+	inline Vec mul(Vec a, Vec b) noexcept { return _mm_mul_ps(a, b); }
+	inline Vec div(Vec a, Vec b) noexcept { return _mm_div_ps(a, b); }
+	inline Vec max(Vec a, Vec b) noexcept { return _mm_max_ps(a, b); }
+
+	inline Mask lessThan(Vec a, Vec b) noexcept { return _mm_cmplt_ps(a, b); }
+	inline Mask greaterEqual(Vec a, Vec b) noexcept { return _mm_cmpge_ps(a, b); }
+	inline Mask notEqual(Vec a, Vec b) noexcept { return _mm_cmpneq_ps(a, b); }
+	inline Vec mask(Mask m, Vec x) noexcept { return _mm_and_ps(m, x); }
+	inline Vec select(Mask m, Vec a, Vec b) noexcept { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+
+	inline float sum(Vec x) noexcept
+	{
+		auto s = _mm_add_ps(x, _mm_movehl_ps(x, x));
+		s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+		return _mm_cvtss_f32(s);
+	}
+
+	inline Int truncate(Vec x) noexcept { return _mm_cvttps_epi32(x); }
+	inline Vec toFloat(Int i) noexcept { return _mm_cvtepi32_ps(i); }
+	inline Vec gather(const float* base, Int idx) noexcept
+	{
+		alignas(16) int i[Width];
+		_mm_store_si128(reinterpret_cast<__m128i*>(i), idx);
+		return _mm_setr_ps(base[i[0]], base[i[1]], base[i[2]], base[i[3]]);
+	}
+#elif PGSIMDNEON
+	static constexpr int Width = 4;
+	using Vec = float32x4_t;
+	using Mask = uint32x4_t;
+	using Int = int32x4_t;
+
+	inline Vec load(const float* x) noexcept { return vld1q_f32(x); }
+	inline void store(float* y, Vec x) noexcept { vst1q_f32(y, x); }
+	inline Vec set(float x) noexcept { return vdupq_n_f32(x); }
+
+	inline Vec add(Vec a, Vec b) noexcept { return vaddq_f32(a, b); }
+	inline Vec sub(Vec a, Vec b) noexcept { return vsubq_f32(a, b); }
+	inline Vec mul(Vec a, Vec b) noexcept { return vmulq_f32(a, b); }
+	inline Vec div(Vec a, Vec b) noexcept { return vdivq_f32(a, b); }
+	inline Vec max(Vec a, Vec b) noexcept { return vmaxq_f32(a, b); }
+
+	inline Mask lessThan(Vec a, Vec b) noexcept { return vcltq_f32(a, b); }
+	inline Mask greaterEqual(Vec a, Vec b) noexcept { return vcgeq_f32(a, b); }
+	inline Mask notEqual(Vec a, Vec b) noexcept { return vmvnq_u32(vceqq_f32(a, b)); }
+	inline Vec mask(Mask m, Vec x) noexcept { return vreinterpretq_f32_u32(vandq_u32(m, vreinterpretq_u32_f32(x))); }
+	inline Vec select(Mask m, Vec a, Vec b) noexcept { return vbslq_f32(m, a, b); }
+
+	inline float sum(Vec x) noexcept { return vaddvq_f32(x); }
+
+	inline Int truncate(Vec x) noexcept { return vcvtq_s32_f32(x); }
+	inline Vec toFloat(Int i) noexcept { return vcvtq_f32_s32(i); }
+	inline Vec gather(const float* base, Int idx) noexcept
+	{
+		int i[Width];
+		vst1q_s32(i, idx);
+		const float y[Width] = { base[i[0]], base[i[1]], base[i[2]], base[i[3]] };
+		return vld1q_f32(y);
+	}
+#else
+	static constexpr int Width = 1;
+	using Vec = float;
+	using Mask = bool;
+	using Int = int;
+
+	inline Vec load(const float* x) noexcept { return *x; }
+	inline void store(float* y, Vec x) noexcept { *y = x; }
+	inline Vec set(float x) noexcept { return x; }
+
+	inline Vec add(Vec a, Vec b) noexcept { return a + b; }
+	inline Vec sub(Vec a, Vec b) noexcept { return a - b; }
+	inline Vec mul(Vec a, Vec b) noexcept { return a * b; }
+	inline Vec div(Vec a, Vec b) noexcept { return a / b; }
+	inline Vec max(Vec a, Vec b) noexcept { return a < b ? b : a; }
+
+	inline Mask lessThan(Vec a, Vec b) noexcept { return a < b; }
+	inline Mask greaterEqual(Vec a, Vec b) noexcept { return a >= b; }
+	inline Mask notEqual(Vec a, Vec b) noexcept { return a != b; }
+	inline Vec mask(Mask m, Vec x) noexcept { return m ? x : 0.f; }
+	inline Vec select(Mask m, Vec a, Vec b) noexcept { return m ? a : b; }
+
+	inline float sum(Vec x) noexcept { return x; }
+
+	inline Int truncate(Vec x) noexcept { return static_cast<int>(x); }
+	inline Vec toFloat(Int i) noexcept { return static_cast<float>(i); }
+	inline Vec gather(const float* base, Int idx) noexcept { return base[idx]; }
+#endif
+}
+
+#undef PGSIMDAVX
+#undef PGSIMDSSE
+#undef PGSIMDNEON
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "Smooth.h"
 #include <cmath>
+#include <algorithm>
 
 template<typename Float>
 void smooth::Smooth<Float>::makeFromDecayInSamples(Float d) noexcept
@@ -37,7 +38,8 @@ smooth::Smooth<Float>::Smooth(const Float _startVal) :
 	b1(static_cast<Float>(0)),
 	y1(_startVal),
 	eps(static_cast<Float>(0)),
-	startVal(_startVal)
+	startVal(_startVal),
+	powers()
 {}
 
 template<typename Float>
@@ -47,13 +49,29 @@ void smooth::Smooth<Float>::reset()
 	b1 = static_cast<Float>(0);
 	y1 = startVal;
 	eps = static_cast<Float>(0);
+	powers.fill(static_cast<Float>(0));
 }
 
 template<typename Float>
-void smooth::Smooth<Float>::operator()(Float* buffer, Float val, int numSamples) noexcept
+bool smooth::Smooth<Float>::operator()(Float* buffer, Float val, int numSamples) noexcept
 {
-	for (auto s = 0; s < numSamples; ++s)
-		buffer[s] = processSample(val);
+	if (std::abs(val - y1) <= eps)
+	{
+		y1 = val;
+		std::fill(buffer, buffer + numSamples, val);
+		return false;
+	}
+
+	for (auto s0 = 0; s0 < numSamples; s0 += NumPowers)
+	{
+		const auto n = std::min(NumPowers, numSamples - s0);
+		const auto d = y1 - val;
+		auto y = buffer + s0;
+		for (auto s = 0; s < n; ++s)
+			y[s] = val + d * powers[s];
+		y1 = y[n - 1];
+	}
+	return true;
 }
 
 template<typename Float>
@@ -82,7 +100,73 @@ void smooth::Smooth<Float>::setX(Float x) noexcept
 	a0 = static_cast<Float>(1) - x;
 	b1 = x;
 	eps = a0 * static_cast<Float>(1.5);
+	auto p = static_cast<Float>(1);
+	for (auto& power : powers)
+	{
+		p *= b1;
+		power = p;
+	}
+}
+
+template<typename Float>
+void smooth::Ramp<Float>::makeFromLengthInSamples(Float l) noexcept
+{
+	length = std::max(1, static_cast<int>(l));
+	remaining = std::min(remaining, length);
+	if (remaining != 0)
+		inc = (dest - y) / static_cast<Float>(remaining);
+}
+
+template<typename Float>
+void smooth::Ramp<Float>::makeFromLengthInMs(Float l, Float Fs) noexcept
+{
+	makeFromLengthInSamples(l * Fs * static_cast<Float>(.001));
+}
+
+template<typename Float>
+smooth::Ramp<Float>::Ramp(const Float _startVal) :
+	y(_startVal),
+	dest(_startVal),
+	inc(static_cast<Float>(0)),
+	startVal(_startVal),
+	length(1),
+	remaining(0)
+{}
+
+template<typename Float>
+void smooth::Ramp<Float>::reset()
+{
+	y = dest = startVal;
+	inc = static_cast<Float>(0);
+	remaining = 0;
+}
+
+template<typename Float>
+bool smooth::Ramp<Float>::operator()(Float* buffer, Float val, int numSamples) noexcept
+{
+	if (val != dest)
+	{
+		dest = val;
+		remaining = length;
+		inc = (dest - y) / static_cast<Float>(length);
+	}
+
+	if (remaining == 0)
+	{
+		std::fill(buffer, buffer + numSamples, dest);
+		return false;
+	}
+
+	const auto n = std::min(remaining, numSamples);
+	for (auto s = 0; s < n; ++s)
+		buffer[s] = y + inc * static_cast<Float>(s + 1);
+	remaining -= n;
+	y = remaining == 0 ? dest : buffer[n - 1];
+	std::fill(buffer + n, buffer + numSamples, dest);
+	return true;
 }
 
 template struct smooth::Smooth<float>;
-template struct smooth::Smooth<double>;
\ No newline at end of file
+template struct smooth::Smooth<double>;
+template struct smooth::Ramp<float>;
+template struct smooth::Ramp<double>;
\ No newline at end of file
@@ -1,10 +1,18 @@
 #pragma once
+#include <array>
 
 namespace smooth
 {
+	/*
+	one pole lowpass. while the target stays the same for a block its
+	trajectory has the closed form val + (y1 - val) * b1^n, so blocks get
+	computed from a table of b1's powers without a serial dependency.
+	*/
 	template<typename Float>
 	struct Smooth
 	{
+		/* the trajectory restarts from the last sample after this many samples */
+		static constexpr int NumPowers = 32;
 		static constexpr Float Pi = static_cast<Float>(3.14159265359);
 		static constexpr Float Tau = Pi * static_cast<Float>(2);
 
@@ -20,14 +28,39 @@ namespace smooth
 
 		void reset();
 
-		void operator()(Float*, Float/*val*/, int/*numSamples*/) noexcept;
+		/* returns false once converged. then buffer is just filled with val */
+		bool operator()(Float*, Float/*val*/, int/*numSamples*/) noexcept;
 		void operator()(Float*, int/*numSamples*/) noexcept;
 		Float operator()(Float) noexcept;
 
 	protected:
 		Float a0, b1, y1, eps, startVal;
+		/* b1^1 .. b1^NumPowers */
+		std::array<Float, NumPowers> powers;
 
 		Float processSample(Float) noexcept;
 	};
 
+	/*
+	linear ramp towards the latest target in a fixed time.
+	cheaper than Smooth where the shape of the transition doesn't matter
+	*/
+	template<typename Float>
+	struct Ramp
+	{
+		void makeFromLengthInSamples(Float) noexcept;
+		void makeFromLengthInMs(Float, Float/*Fs*/) noexcept;
+
+		Ramp(const Float /*_startVal*/ = static_cast<Float>(0));
+
+		void reset();
+
+		/* returns false if the ramp had already ended. then buffer is just filled with val */
+		bool operator()(Float*, Float/*val*/, int/*numSamples*/) noexcept;
+
+	protected:
+		Float y, dest, inc, startVal;
+		int length, remaining;
+	};
+
 }
\ No newline at end of file
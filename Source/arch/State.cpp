@@ -1,5 +1,14 @@
 #include "State.h"
 
+sta::State::Path::Path(const String& key, const String& id) :
+	nodes(),
+	prop(id.removeCharacters(" ").toLowerCase())
+{
+	const auto tokens = juce::StringArray::fromTokens(key.removeCharacters(" ").toLowerCase(), "/", "");
+	for (const auto& token : tokens)
+		nodes.push_back(token);
+}
+
 sta::State::State() :
 	state("state"),
 	undoer()
@@ -48,6 +57,43 @@ void sta::State::loadPatch(const juce::File& xmlFile)
 	state = ValueTree::fromXml(*xml);
 }
 
+void sta::State::savePatch(juce::OutputStream& stream, const juce::Identifier& skip) const
+{
+	const auto numChildren = state.getNumChildren();
+	const auto skipped = state.getChildWithName(skip).isValid() ? 1 : 0;
+	stream.writeCompressedInt(numChildren - skipped);
+	for (auto i = 0; i < numChildren; ++i)
+	{
+		const auto child = state.getChild(i);
+		if (child.getType() != skip)
+			child.writeToStream(stream);
+	}
+}
+
+bool sta::State::readPatch(juce::InputStream& stream, ValueTree& nState) const
+{
+	if (stream.isExhausted())
+		return false;
+	const auto numChildren = stream.readCompressedInt();
+	if (numChildren < 0)
+		return false;
+
+	nState = ValueTree(state.getType());
+	for (auto i = 0; i < numChildren; ++i)
+	{
+		auto child = ValueTree::readFromStream(stream);
+		if (!child.isValid())
+			return false;
+		nState.appendChild(child, nullptr);
+	}
+	return true;
+}
+
+void sta::State::loadPatch(ValueTree&& nState) noexcept
+{
+	state = std::move(nState);
+}
+
 void sta::State::set(String&& key, String&& id, Var&& val, bool undoable)
 {
 	if (undoable)
@@ -92,6 +138,41 @@ void sta::State::set(const String& key, const String& id, Var&& val, bool undoab
 		setProperty(toID(key), toID(id), std::move(val), state, nullptr);
 }
 
+void sta::State::set(const Path& path, Var&& val, bool undoable)
+{
+	auto knot = state;
+	for (const auto& node : path.nodes)
+	{
+		auto child = knot.getChildWithName(node);
+		if (!child.isValid())
+		{
+			child = ValueTree(node);
+			knot.appendChild(child, nullptr);
+		}
+		knot = child;
+	}
+
+	if (undoable)
+	{
+		undoer.beginNewTransaction();
+		knot.setProperty(path.prop, std::move(val), &undoer);
+	}
+	else
+		knot.setProperty(path.prop, std::move(val), nullptr);
+}
+
+const sta::State::Var* sta::State::get(const Path& path) const
+{
+	auto knot = state;
+	for (const auto& node : path.nodes)
+	{
+		knot = knot.getChildWithName(node);
+		if (!knot.isValid())
+			return nullptr;
+	}
+	return knot.getPropertyPointer(path.prop);
+}
+
 const sta::State::Var* sta::State::get(String&& key, String&& id) const
 {
 	return getProperty(key, toID(id), state);
@@ -13,8 +13,19 @@ namespace sta
 		using XML = std::unique_ptr<juce::XmlElement>;
 		using XMLDoc = juce::XmlDocument;
 		using Proc = juce::AudioProcessor;
+		using Identifier = juce::Identifier;
 
 	public:
+		/* a key and a property id, split into interned identifiers once.
+		lookups with it only compare pointers */
+		struct Path
+		{
+			Path(const String& /*key*/, const String& /*id*/);
+
+			std::vector<Identifier> nodes;
+			Identifier prop;
+		};
+
 		State();
 
 		void savePatch(const Proc&, juce::MemoryBlock&) const;
@@ -29,6 +40,14 @@ namespace sta
 
 		void loadPatch(const juce::File&);
 
+		/* writes the state in juce's binary format, leaving out the child named skip */
+		void savePatch(juce::OutputStream&, const juce::Identifier& /*skip*/) const;
+
+		/* only reads. returns false if the data is broken */
+		bool readPatch(juce::InputStream&, ValueTree&) const;
+
+		void loadPatch(ValueTree&&) noexcept;
+
 		void set(String&& /*key*/, String&& /*id*/, Var&&, bool /*undoable*/ = true);
 
 		void set(String&& /*key*/, const String& /*id*/, Var&&, bool /*undoable*/ = true);
@@ -37,6 +56,10 @@ namespace sta
 
 		void set(const String& /*key*/, const String& /*id*/, Var&&, bool /*undoable*/ = true);
 
+		void set(const Path&, Var&&, bool /*undoable*/ = true);
+
+		const Var* get(const Path&) const;
+
 		const Var* get(String&& /*key*/, String&& /*id*/) const;
 
 		const Var* get(String&& /*key*/, const String& /*id*/) const;
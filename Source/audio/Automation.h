@@ -0,0 +1,136 @@
+#pragma once
+#include <juce_core/juce_core.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <array>
+
+#include "../param/Param.h"
+
+#include "../config.h"
+
+namespace audio
+{
+	/*
+	sample-accurate parameter automation.
+
+	timestamped parameter changes get pushed into a lock-free queue. the audio
+	thread splits its blocks at their change points, so the result doesn't
+	depend on the host's block size. change points snap up to a grid of
+	PPDAutomationGrid samples, counted from prepareToPlay, so they land on the
+	same samples with any host block size.
+	midi ccs split blocks at their sample position, unless that is closer
+	than the grid to either end of the sub-block. then they get applied at
+	its start. sub-blocks are only shorter than the grid where the host
+	block starts or ends off the grid.
+	*/
+	class Automation
+	{
+		using Params = param::Params;
+		using MIDIBuf = juce::MidiBuffer;
+		using Int64 = juce::int64;
+
+		static constexpr int Capacity = 1 << 12;
+		static constexpr int Grid = PPDAutomationGrid;
+	public:
+		struct Event
+		{
+			/* in samples since prepareToPlay */
+			Int64 time;
+			int paramIdx;
+			float valNorm;
+		};
+
+		Automation(Params& _params) :
+			params(_params),
+			fifo(Capacity),
+			events(),
+			pos(0)
+		{}
+
+		// PRODUCER THREAD (only one at a time):
+
+		/* events must be pushed in chronological order. returns false if the queue is full */
+		bool push(const Event& e) noexcept
+		{
+			if (e.paramIdx < 0 || e.paramIdx >= static_cast<int>(params.numParams()))
+				return false;
+
+			int start1, size1, start2, size2;
+			fifo.prepareToWrite(1, start1, size1, start2, size2);
+			if (size1 == 0)
+				return false;
+			events[start1] = e;
+			fifo.finishedWrite(1);
+			return true;
+		}
+
+		// AUDIO THREAD:
+
+		/* restarts the timeline. call from prepareToPlay */
+		void prepare() noexcept
+		{
+			pos = 0;
+		}
+
+		/* applies the changes that are due at start. returns the end of the sub-block */
+		int operator()(const MIDIBuf& midi, int start, int numSamples) noexcept
+		{
+			auto end = numSamples;
+
+			for (;;)
+			{
+				int start1, size1, start2, size2;
+				fifo.prepareToRead(1, start1, size1, start2, size2);
+				if (size1 == 0)
+					break;
+
+				const auto& e = events[start1];
+				const auto time = snap(e.time) - pos;
+				if (time > start)
+				{
+					end = static_cast<int>(std::min(time, static_cast<Int64>(numSamples)));
+					break;
+				}
+
+				params[e.paramIdx]->setValue(e.valNorm);
+				fifo.finishedRead(1);
+			}
+
+#if PPDHasMIDILearn
+			for (auto it = midi.findNextSamplePosition(start + Grid); it != midi.cend(); ++it)
+			{
+				const auto ref = *it;
+				if (ref.samplePosition > end - Grid)
+					break;
+				if (ref.getMessage().isController())
+				{
+					end = ref.samplePosition;
+					break;
+				}
+			}
+#else
+			juce::ignoreUnused(midi);
+#endif
+
+			return end;
+		}
+
+		/* call at the end of each block */
+		void advance(int numSamples) noexcept
+		{
+			pos += numSamples;
+		}
+
+	protected:
+		Params& params;
+		juce::AbstractFifo fifo;
+		std::array<Event, Capacity> events;
+		Int64 pos;
+
+		static Int64 snap(Int64 time) noexcept
+		{
+			return time <= 0 ? 0 : (time + Grid - 1) / Grid * Grid;
+		}
+	};
+}
+
+#include "../configEnd.h"
\ No newline at end of file
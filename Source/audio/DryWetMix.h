@@ -1,6 +1,7 @@
 #pragma once
 #include "../arch/Smooth.h"
-#include "WHead.h"
+#include "LatencyCompensation.h"
+#include "Meter.h"
 #include <array>
 
 #include "../config.h"
@@ -9,63 +10,6 @@ namespace audio
 {
 	class DryWetMix
 	{
-		struct LatencyCompensation
-		{
-			LatencyCompensation() :
-				ring(),
-				wHead(),
-				latency(0)
-			{}
-
-			void prepare(int blockSize, int _latency)
-			{
-				latency = _latency;
-				if (latency != 0)
-				{
-					ring.setSize(2, latency, false, true, false);
-					wHead.prepare(blockSize, latency);
-				}
-				else
-				{
-					ring.setSize(0, 0);
-					wHead.prepare(0, 0);
-				}
-			}
-
-			void operator()(float** dry, float** inputSamples, int numChannels, int numSamples) noexcept
-			{
-				if (latency != 0)
-				{
-					wHead(numSamples);
-
-					for (auto ch = 0; ch < numChannels; ++ch)
-					{
-						const auto smpls = inputSamples[ch];
-
-						auto rng = ring.getWritePointer(ch);
-						auto dr = dry[ch];
-
-						for (auto s = 0; s < numSamples; ++s)
-						{
-							const auto w = wHead[s];
-							const auto r = (w + 1) % latency;
-
-							rng[w] = smpls[s];
-							dr[s] = rng[r];
-						}
-					}
-				}
-				else
-					for(auto ch = 0; ch < numChannels; ++ch)
-						SIMD::copy(dry[ch], inputSamples[ch], numSamples);
-			}
-
-		protected:
-			AudioBuffer ring;
-			WHead wHead;
-			int latency;
-		};
-
 		enum
 		{
 #if PPDHasGainIn
@@ -86,14 +30,18 @@ namespace audio
 			mixSmooth(1.f),
 			gainSmooth(1.f),
 
-			dryBuf()
+			dryBuf(),
+
+			mixSmoothing(true),
+			gainSmoothing(true),
+			dryNeeded(true)
 		{}
 
 		void prepare(float sampleRate, int blockSize, int latency)
 		{
 			latencyCompensation.prepare(blockSize, latency);
 
-			mixSmooth.makeFromDecayInMs(20.f, sampleRate);
+			mixSmooth.makeFromLengthInMs(20.f, sampleRate);
 			gainSmooth.makeFromDecayInMs(20.f, sampleRate);
 
 			dryBuf.setSize(2, blockSize, false, true, false);
@@ -102,10 +50,11 @@ namespace audio
 				buf.resize(blockSize);
 		}
 
+		/* with an input gain, the input meter happens in here */
 		void saveDry(
 			float** samples, int numChannels, int numSamples,
 #if PPDHasGainIn
-			float gainInP,
+			Meters& meters, float gainInP,
 #endif
 			float mixP, float gainP
 #if PPDHasPolarity
@@ -116,88 +65,84 @@ namespace audio
 #endif
 			) noexcept
 		{
-			latencyCompensation(
-				dryBuf.getArrayOfWritePointers(),
-				samples,
-				numChannels,
-				numSamples
-			);
-
-#if PPDHasGainIn
-			auto gainInBuf = bufs[GainIn].data();
-			gainInSmooth(gainInBuf, juce::Decibels::decibelsToGain(gainInP), numSamples);
-			for (auto ch = 0; ch < numChannels; ++ch)
-				for (auto s = 0; s < numSamples; ++s)
-					samples[ch][s] *= gainInBuf[s];
-#if PPDHasUnityGain
+#if PPDHasGainIn && PPDHasUnityGain
 			gainP -= gainInP * unityGainP;
 #endif
-#endif
-
 			auto mixBuf = bufs[MixW].data();
-			mixSmooth(mixBuf, mixP, numSamples);
+			mixSmoothing = mixSmooth(mixBuf, mixP, numSamples);
 
 #if PPDHasPolarity
 			gainP *= polarityP;
 #endif
-			gainSmooth(bufs[Gain].data(), juce::Decibels::decibelsToGain(gainP), numSamples);
+			gainSmoothing = gainSmooth(bufs[Gain].data(), juce::Decibels::decibelsToGain(gainP), numSamples);
 
+			/* a constant mix only needs its first value */
+			const auto numMix = mixSmoothing ? numSamples : 1;
 #if PPDEqualLoudnessMix
-			for (auto s = 0; s < numSamples; ++s)
+			for (auto s = 0; s < numMix; ++s)
 			{
 				bufs[MixD][s] = std::sqrt(1.f - mixBuf[s]);
 				bufs[MixW][s] = std::sqrt(mixBuf[s]);
 			}
 #else
-			for (auto s = 0; s < numSamples; ++s)
+			for (auto s = 0; s < numMix; ++s)
 			{
 				bufs[MixD][s] = 1.f - mixBuf[s];
 				bufs[MixW][s] = mixBuf[s];
 			}
 #endif
+
+			/* the wet path works in place, so the dry signal can't just alias the input.
+			it's not copied at all, if the mix is fully wet */
+			dryNeeded = mixSmoothing || bufs[MixD][0] != 0.f;
+			const auto copyDry = dryNeeded && latencyCompensation.getLatency() == 0;
+			latencyCompensation.write(samples, numChannels, numSamples);
+			if (dryNeeded && !copyDry)
+				latencyCompensation.read(dryBuf.getArrayOfWritePointers(), numChannels, numSamples);
+
+#if PPDHasGainIn
+			gainInSmooth(bufs[GainIn].data(), juce::Decibels::decibelsToGain(gainInP), numSamples);
+			if (copyDry)
+				processIn<true>(samples, numChannels, numSamples, meters);
+			else
+				processIn<false>(samples, numChannels, numSamples, meters);
+#else
+			if (copyDry)
+				for (auto ch = 0; ch < numChannels; ++ch)
+					SIMD::copy(dryBuf.getWritePointer(ch), samples[ch], numSamples);
+#endif
 		}
 
+		/* without latency the input is the dry signal already */
 		void processBypass(float** samples, int numChannels, int numSamples) noexcept
 		{
-			latencyCompensation(
-				dryBuf.getArrayOfWritePointers(),
-				samples,
-				numChannels,
-				numSamples
-			);
-
-			for (auto ch = 0; ch < numChannels; ++ch)
-			{
-				const auto dry = dryBuf.getReadPointer(ch);
-
-				auto smpls = samples[ch];
-
-				for (auto s = 0; s < numSamples; ++s)
-					smpls[s] = dry[s];
-			}
+			latencyCompensation(samples, samples, numChannels, numSamples);
 		}
 
-		void processOutGain(float** samples, int numChannels, int numSamples) const noexcept
+		/* decodes mid/side, applies the output gain, meters the output and mixes it
+		with the dry signal, all in one pass over the block */
+		void processOut(float** samples, int numChannels, int numSamples, Meters& meters, bool midSide) noexcept
 		{
-			for (auto ch = 0; ch < numChannels; ++ch)
+			if (mixSmoothing)
 			{
-				const auto gainBuf = bufs[Gain].data();
-				SIMD::multiply(samples[ch], gainBuf, numSamples);
+				if (gainSmoothing)
+					processOut<true, true, true>(samples, numChannels, numSamples, meters, midSide);
+				else
+					processOut<false, true, true>(samples, numChannels, numSamples, meters, midSide);
 			}
-		}
-
-		void processMix(float** samples, int numChannels, int numSamples) const noexcept
-		{
-			for (auto ch = 0; ch < numChannels; ++ch)
+			else if (dryNeeded)
+			{
+				if (gainSmoothing)
+					processOut<true, false, true>(samples, numChannels, numSamples, meters, midSide);
+				else
+					processOut<false, false, true>(samples, numChannels, numSamples, meters, midSide);
+			}
+			else
 			{
-				const auto dry = dryBuf.getReadPointer(ch);
-				const auto mixD = bufs[MixD].data();
-				const auto mixW = bufs[MixW].data();
-				
-				auto smpls = samples[ch];
-
-				for (auto s = 0; s < numSamples; ++s)
-					smpls[s] = dry[s] * mixD[s] + smpls[s] * mixW[s];
+				if (gainSmoothing)
+					processOut<true, false, false>(samples, numChannels, numSamples, meters, midSide);
+				else
+					processOut<false, false, false>(samples, numChannels, numSamples, meters, midSide);
 			}
 		}
 
@@ -209,9 +154,143 @@ namespace audio
 #if PPDHasGainIn
 		Smooth gainInSmooth;
 #endif
-		Smooth mixSmooth, gainSmooth;
+		/* the mix is a linear crossfade anyway */
+		Ramp mixSmooth;
+		Smooth gainSmooth;
 
 		AudioBuffer dryBuf;
+		bool mixSmoothing, gainSmoothing, dryNeeded;
+
+	private:
+#if PPDHasGainIn
+		template<bool CopyDry>
+		void processIn(float** samples, int numChannels, int numSamples, Meters& meters) noexcept
+		{
+			const auto gainIn = bufs[GainIn].data();
+			auto dryL = dryBuf.getWritePointer(0);
+
+			if (numChannels == 1)
+			{
+				auto smpls = samples[0];
+
+				meters.processIn(numChannels, numSamples, [&](int start, int end, float rect)
+				{
+					for (auto s = start; s < end; ++s)
+					{
+						const auto x = smpls[s];
+						if constexpr (CopyDry)
+							dryL[s] = x;
+						const auto y = x * gainIn[s];
+						smpls[s] = y;
+						rect = Meters::accumulate(rect, y);
+					}
+					return rect;
+				});
+				return;
+			}
+
+			auto dryR = dryBuf.getWritePointer(1);
+			auto smplsL = samples[0];
+			auto smplsR = samples[1];
+
+			meters.processIn(numChannels, numSamples, [&](int start, int end, float rect)
+			{
+				for (auto s = start; s < end; ++s)
+				{
+					const auto l = smplsL[s];
+					const auto r = smplsR[s];
+					if constexpr (CopyDry)
+					{
+						dryL[s] = l;
+						dryR[s] = r;
+					}
+					const auto g = gainIn[s];
+					smplsL[s] = l * g;
+					smplsR[s] = r * g;
+					rect = Meters::accumulate(rect, l * g + r * g);
+				}
+				return rect;
+			});
+		}
+#endif
+
+		/* the gain and the mix are only read per sample while they're smoothing.
+		without the dry signal the mix is fully wet */
+		template<bool GainSmoothing, bool MixSmoothing, bool HasDry>
+		void processOut(float** samples, int numChannels, int numSamples, Meters& meters, bool midSide) noexcept
+		{
+			const auto gainBuf = bufs[Gain].data();
+			const auto mixDBuf = bufs[MixD].data();
+			const auto mixWBuf = bufs[MixW].data();
+			const auto gain0 = gainBuf[0];
+			const auto mixD0 = mixDBuf[0];
+			const auto mixW0 = mixWBuf[0];
+
+			const auto gain = [=](int s)
+			{
+				if constexpr (GainSmoothing)
+					return gainBuf[s];
+				else
+					return gain0;
+			};
+
+			const auto mix = [=](float wet, const float* dry, int s)
+			{
+				if constexpr (MixSmoothing)
+					return dry[s] * mixDBuf[s] + wet * mixWBuf[s];
+				else if constexpr (HasDry)
+					return wet * mixW0 + dry[s] * mixD0;
+				else
+					return wet * mixW0;
+			};
+
+			const auto dryL = dryBuf.getReadPointer(0);
+
+			if (numChannels == 1)
+			{
+				auto smpls = samples[0];
+
+				meters.processOut(numChannels, numSamples, [&](int start, int end, float rect)
+				{
+					for (auto s = start; s < end; ++s)
+					{
+						const auto y = smpls[s] * gain(s);
+						rect = Meters::accumulate(rect, y);
+						smpls[s] = mix(y, dryL, s);
+					}
+					return rect;
+				});
+				return;
+			}
+
+			const auto dryR = dryBuf.getReadPointer(1);
+			auto smplsL = samples[0];
+			auto smplsR = samples[1];
+
+			meters.processOut(numChannels, numSamples, [&](int start, int end, float rect)
+			{
+				for (auto s = start; s < end; ++s)
+				{
+					auto l = smplsL[s];
+					auto r = smplsR[s];
+					/* folds away, unless there is a stereo config */
+					if (PPDHasStereoConfig && midSide)
+					{
+						const auto mid = l;
+						l = mid + r;
+						r = mid - r;
+					}
+
+					const auto g = gain(s);
+					l *= g;
+					r *= g;
+					rect = Meters::accumulate(rect, l + r);
+					smplsL[s] = mix(l, dryL, s);
+					smplsR[s] = mix(r, dryR, s);
+				}
+				return rect;
+			});
+		}
 	};
 }
 
@@ -0,0 +1,96 @@
+#pragma once
+#include <juce_core/juce_core.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace audio
+{
+	/*
+	hands fully prepared engines from the message thread to the audio thread.
+
+	the message thread builds an engine, which can allocate, and publishes it.
+	the audio thread picks it up with a pointer swap at the start of a block and
+	hands the old one back. the message thread deletes it later, so the audio
+	thread never allocates or frees anything.
+
+	engines can be published from any thread but the audio thread. one that
+	gets replaced before it was picked up might still be in use through
+	getLatest, so it is only deleted by the next collect.
+	*/
+	template<class Engine>
+	struct EngineSwap
+	{
+		EngineSwap() :
+			active(new Engine()),
+			latest(active),
+			pending(nullptr),
+			retired(nullptr),
+			supersededLock(),
+			superseded()
+		{}
+
+		~EngineSwap()
+		{
+			delete retired.exchange(nullptr);
+			delete pending.exchange(nullptr);
+			delete active;
+		}
+
+		// ANY THREAD BUT THE AUDIO THREAD:
+
+		void publish(std::unique_ptr<Engine>&& engine)
+		{
+			/* the audio thread is done with the retired one, so it can go now */
+			delete retired.exchange(nullptr);
+			latest.store(engine.get());
+			/* an engine that was never picked up goes next time collect is called */
+			std::unique_ptr<Engine> unpicked(pending.exchange(engine.release()));
+			if (unpicked != nullptr)
+			{
+				const juce::ScopedLock lock(supersededLock);
+				superseded.push_back(std::move(unpicked));
+			}
+		}
+
+		// MESSAGE THREAD:
+
+		/* the engine that was published last. it might not be active yet */
+		Engine& getLatest() noexcept { return *latest.load(); }
+
+		/* deletes the engines that were swapped out or replaced, if any */
+		void collect()
+		{
+			delete retired.exchange(nullptr);
+			const juce::ScopedLock lock(supersededLock);
+			superseded.clear();
+		}
+
+		// AUDIO THREAD:
+
+		/* call at the start of each block. a new engine waits until the
+		message thread has collected the one swapped out before, so that
+		one can't get lost */
+		Engine& acquire() noexcept
+		{
+			if (pending.load() != nullptr && retired.load() == nullptr)
+			{
+				auto engine = pending.exchange(nullptr);
+				if (engine != nullptr)
+				{
+					retired.store(active);
+					active = engine;
+				}
+			}
+			return *active;
+		}
+
+		Engine& get() noexcept { return *active; }
+
+	protected:
+		Engine* active;
+		std::atomic<Engine*> latest, pending, retired;
+		juce::CriticalSection supersededLock;
+		std::vector<std::unique_ptr<Engine>> superseded;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,217 @@
+#pragma once
+#include "Oversampling.h"
+#include "LatencyCompensation.h"
+#include <array>
+#include <atomic>
+
+namespace audio
+{
+	/*
+	changes the oversampling factor while the processor keeps running.
+
+	the idle path gets prepared on the message thread. the audio thread then
+	runs both paths until the new one has warmed up and crossfades to it.
+	every path is padded to the latency of the highest factor, so both paths
+	are aligned and the reported latency never changes.
+	*/
+	class HQSwitch
+	{
+		static constexpr float FadeMs = 20.f;
+
+		enum class Stage
+		{
+			Steady,
+			Preparing,
+			Ready,
+			Fading,
+			NumStages
+		};
+
+		struct Path
+		{
+			Path() :
+				oversampler(),
+				pad(),
+				buffer()
+			{}
+
+			Oversampler oversampler;
+			LatencyCompensation pad;
+			AudioBuffer buffer;
+		};
+
+	public:
+		HQSwitch() :
+			paths(),
+			stage(Stage::Steady),
+			active(0),
+
+			Fs(1.),
+			blockSize(0),
+			latency(0),
+
+			warmUpMs(0.f),
+			warmUp(0),
+			fadeIdx(0),
+			fadeLength(1),
+			fading(false)
+		{}
+
+		/* not realtime-safe. prepares the active path and returns the fixed latency */
+		int prepare(double sampleRate, int _blockSize, int order)
+		{
+			Fs = sampleRate;
+			blockSize = _blockSize;
+			latency = Oversampler::getMaxLatency(Fs);
+			fadeLength = static_cast<int>(msInSamples(FadeMs, static_cast<float>(Fs)));
+			if (fadeLength < 1)
+				fadeLength = 1;
+
+			stage.store(Stage::Steady);
+			fading = false;
+			preparePath(active, order);
+			return latency;
+		}
+
+		// MESSAGE THREAD:
+
+		bool shallPrepare(int order) const noexcept
+		{
+			return blockSize != 0 && stage.load() == Stage::Steady && paths[active].oversampler.getOrder() != order;
+		}
+
+		/* prepares the idle path for the new order and returns its index */
+		int beginPreparing(int order)
+		{
+			stage.store(Stage::Preparing);
+			const auto idle = 1 - active;
+			preparePath(idle, order);
+			return idle;
+		}
+
+		/* hands the prepared path over to the audio thread */
+		void finishPreparing() noexcept
+		{
+			stage.store(Stage::Ready);
+		}
+
+		double getFsUp(int pathIdx) const noexcept { return paths[pathIdx].oversampler.getFsUp(); }
+		int getBlockSizeUp(int pathIdx) const noexcept { return paths[pathIdx].oversampler.getBlockSizeUp(); }
+		int getActive() const noexcept { return active; }
+
+		// AUDIO THREAD:
+
+		/* how long the new path runs silently before the crossfade starts */
+		void setWarmUpMs(float ms) noexcept { warmUpMs = ms; }
+
+		/* call once per block. returns the number of paths to process */
+		int getNumPaths() noexcept
+		{
+			if (stage.load() == Stage::Ready)
+			{
+				stage.store(Stage::Fading);
+				fading = true;
+				warmUp = static_cast<int>(msInSamples(warmUpMs, static_cast<float>(Fs)));
+				fadeIdx = 0;
+			}
+			return fading ? 2 : 1;
+		}
+
+		/* path 0 is the active one, path 1 the one that fades in */
+		int getPathIdx(int p) const noexcept { return p == 0 ? active : 1 - active; }
+
+		AudioBuffer& upsample(int p, AudioBuffer& buffer) noexcept
+		{
+			auto& path = paths[getPathIdx(p)];
+			if (!fading)
+				return path.oversampler.upsample(buffer);
+
+			const auto numChannels = buffer.getNumChannels();
+			const auto numSamples = buffer.getNumSamples();
+			path.buffer.setSize(numChannels, numSamples, false, false, true);
+			for (auto ch = 0; ch < numChannels; ++ch)
+				SIMD::copy(path.buffer.getWritePointer(ch), buffer.getReadPointer(ch), numSamples);
+
+			return path.oversampler.upsample(path.buffer);
+		}
+
+		void downsample(int p, AudioBuffer& buffer) noexcept
+		{
+			auto& path = paths[getPathIdx(p)];
+			auto& buf = fading ? path.buffer : buffer;
+
+			path.oversampler.downsample(buf);
+
+			auto samples = buf.getArrayOfWritePointers();
+			path.pad(samples, samples, buf.getNumChannels(), buf.getNumSamples());
+		}
+
+		/* writes the crossfade of both paths into buffer, if fading */
+		void operator()(AudioBuffer& buffer) noexcept
+		{
+			if (!fading)
+				return;
+
+			const auto& bufA = paths[active].buffer;
+			const auto& bufB = paths[1 - active].buffer;
+			const auto numChannels = buffer.getNumChannels();
+			const auto numSamples = buffer.getNumSamples();
+			const auto fadeInv = 1.f / static_cast<float>(fadeLength);
+
+			auto wu = warmUp;
+			auto fi = fadeIdx;
+			for (auto ch = 0; ch < numChannels; ++ch)
+			{
+				const auto a = bufA.getReadPointer(ch);
+				const auto b = bufB.getReadPointer(ch);
+				auto smpls = buffer.getWritePointer(ch);
+
+				wu = warmUp;
+				fi = fadeIdx;
+				for (auto s = 0; s < numSamples; ++s)
+				{
+					auto g = 0.f;
+					if (wu > 0)
+						--wu;
+					else if (fi < fadeLength)
+						g = static_cast<float>(fi++) * fadeInv;
+					else
+						g = 1.f;
+
+					smpls[s] = a[s] + g * (b[s] - a[s]);
+				}
+			}
+			warmUp = wu;
+			fadeIdx = fi;
+
+			if (warmUp == 0 && fadeIdx == fadeLength)
+			{
+				active = 1 - active;
+				fading = false;
+				stage.store(Stage::Steady);
+			}
+		}
+
+	protected:
+		std::array<Path, 2> paths;
+		std::atomic<Stage> stage;
+		int active;
+
+		double Fs;
+		int blockSize, latency;
+
+		float warmUpMs;
+		int warmUp, fadeIdx, fadeLength;
+		bool fading;
+
+	private:
+		void preparePath(int idx, int order)
+		{
+			auto& path = paths[idx];
+			path.oversampler.setOrder(order);
+			path.oversampler.prepare(Fs, blockSize);
+			path.pad.prepare(blockSize, latency - path.oversampler.getLatency());
+			path.buffer.setSize(2, blockSize, false, true, false);
+		}
+	};
+}
\ No newline at end of file
@@ -0,0 +1,77 @@
+#pragma once
+#include "RingBuffer.h"
+#include <array>
+
+namespace audio
+{
+	/* delays a signal by a fixed number of samples.
+	every block goes in and out of the ring with one copy per channel each,
+	so the latency can be anything, also longer than a block */
+	struct LatencyCompensation
+	{
+		LatencyCompensation() :
+			rings(),
+			wHead(0),
+			rHead(0),
+			latency(0)
+		{}
+
+		void prepare(int blockSize, int _latency)
+		{
+			latency = _latency;
+			wHead = rHead = 0;
+			/* the oldest sample that's read and the newest one that's written */
+			for (auto& ring : rings)
+				if (latency != 0)
+					ring.prepare(latency + blockSize);
+				else
+					ring = RingBuffer();
+		}
+
+		/* puts a block into the ring. call this for every block, even if
+		its delayed version isn't needed. does nothing without latency */
+		void write(const float* const* inputSamples, int numChannels, int numSamples) noexcept
+		{
+			if (latency == 0)
+				return;
+
+			const auto size = rings[0].getSize();
+			rHead = wHead - latency;
+			if (rHead < 0)
+				rHead += size;
+
+			for (auto ch = 0; ch < numChannels; ++ch)
+				rings[ch].write(wHead, inputSamples[ch], numSamples);
+
+			wHead += numSamples;
+			if (wHead >= size)
+				wHead -= size;
+		}
+
+		/* the block that was written last, delayed. only with latency */
+		void read(float** dry, int numChannels, int numSamples) const noexcept
+		{
+			for (auto ch = 0; ch < numChannels; ++ch)
+				rings[ch].read(dry[ch], rHead, numSamples);
+		}
+
+		/* dry and inputSamples can be the same buffer */
+		void operator()(float** dry, float** inputSamples, int numChannels, int numSamples) noexcept
+		{
+			if (latency != 0)
+			{
+				write(inputSamples, numChannels, numSamples);
+				read(dry, numChannels, numSamples);
+			}
+			else if (dry != inputSamples)
+				for(auto ch = 0; ch < numChannels; ++ch)
+					SIMD::copy(dry[ch], inputSamples[ch], numSamples);
+		}
+
+		int getLatency() const noexcept { return latency; }
+
+	protected:
+		std::array<RingBuffer, 2> rings;
+		int wHead, rHead, latency;
+	};
+}
\ No newline at end of file
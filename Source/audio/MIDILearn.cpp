@@ -1,80 +1,206 @@
 #include "MIDILearn.h"
 
-audio::MIDILearn::CC::CC() :
-	param(nullptr)
-{}
-
-void audio::MIDILearn::CC::setValue(int _value)
+audio::MIDILearn::Table::Table() :
+	cc(),
+	hiRes(),
+	nrpn()
 {
-	auto p = param.load();
-	if (p == nullptr)
-		return;
+	cc.fill(-1);
+	hiRes.fill(false);
+}
 
-	const auto value = static_cast<float>(_value) * ValInv;
+int audio::MIDILearn::Table::operator()(int controller) const noexcept
+{
+	if (controller < NumCCs)
+		return cc[controller];
 
-	p->setValueWithGesture(value);
+	const auto n = controller - NRPNOffset;
+	const auto it = std::lower_bound(nrpn.begin(), nrpn.end(), n, [](const auto& a, int b)
+	{
+		return a.first < b;
+	});
+	if (it != nrpn.end() && it->first == n)
+		return it->second;
+	return -1;
 }
 
 audio::MIDILearn::MIDILearn(Params& _params, State& _state) :
-	ccBuf(),
 	ccIdx(-1),
 	assignableParam(nullptr),
 	params(_params),
-	state(_state)
+	state(_state),
+	ccPaths(),
+	hiResPaths(),
+	nrpnPath("midilearn/nrpn", "map"),
+	mappings(),
+	hiResMappings(),
+	mappingLock(),
+	tables(),
+	unsaved(false),
+	msb(),
+	nrpn(-1),
+	nrpnMSB(0),
+	dataMSB(0),
+	hostValues(),
+	hostPending(),
+	hostFifo(2 * NumParams + 1),
+	hostQueue(),
+	learnFifo(MaxLearnEvents),
+	learnQueue()
 {
+	ccPaths.reserve(NumCCs);
+	for (auto i = 0; i < NumCCs; ++i)
+		ccPaths.emplace_back("midilearn/cc" + String(i), "id");
+	hiResPaths.reserve(NumHiResCCs);
+	for (auto i = 0; i < NumHiResCCs; ++i)
+		hiResPaths.emplace_back("midilearn/cc" + String(i), "hires");
+	hiResMappings.fill(false);
+	msb.fill(0);
+	for (auto& v : hostValues)
+		v.store(0.f);
+	for (auto& p : hostPending)
+		p.store(false);
+	startTimerHz(FlushHz);
 }
 
-void audio::MIDILearn::savePatch() const
+void audio::MIDILearn::savePatch()
 {
-	for (auto i = 0; i < ccBuf.size(); ++i)
+	const Lock lock(mappingLock);
+	if (!unsaved)
+		return;
+	unsaved = false;
+
+	for (auto i = 0; i < NumCCs; ++i)
 	{
-		const auto& cc = ccBuf[i];
-		const auto prm = cc.param.load();
-		if (prm != nullptr)
-			state.set(getIDString(i), "id", param::toID(param::toString(prm->id)), true);
+		const auto it = mappings.find(i);
+		if (it != mappings.end())
+			state.set(ccPaths[i], param::toID(params[it->second]->id), false);
+		/* clears mappings that got removed */
+		else if (state.get(ccPaths[i]) != nullptr)
+			state.set(ccPaths[i], "", false);
+
+		if (i < NumHiResCCs && (hiResMappings[i] || state.get(hiResPaths[i]) != nullptr))
+			state.set(hiResPaths[i], hiResMappings[i], false);
 	}
+
+	String nrpns;
+	for (auto it = mappings.lower_bound(NRPNOffset); it != mappings.end(); ++it)
+		nrpns << String(it->first - NRPNOffset) << "=" << param::toID(params[it->second]->id) << ",";
+	state.set(nrpnPath, nrpns, false);
 }
 
 void audio::MIDILearn::loadPatch()
 {
-	for (auto i = 0; i < ccBuf.size(); ++i)
+	const Lock lock(mappingLock);
+	mappings.clear();
+	hiResMappings.fill(false);
+
+	/* only looks at the mappings that exist */
+	const auto node = state.getState().getChildWithName(nrpnPath.nodes.front());
+	for (const auto& child : node)
 	{
-		const auto var = state.get(getIDString(i), "id");
-		if (var)
-		{
-			const auto idStr = var->toString();
+		const auto& name = child.getType().toString();
+		if (!name.startsWith("cc"))
+			continue;
+		const auto cc = name.getTrailingIntValue();
+		const auto var = child.getPropertyPointer(ccPaths.front().prop);
+		if (var == nullptr || cc < 0 || cc >= NumCCs)
+			continue;
+		const auto pID = param::toPID(var->toString());
+		if (pID == PID::NumParams)
+			continue;
+		mappings[cc] = static_cast<int>(pID);
+		if (cc < NumHiResCCs)
+			hiResMappings[cc] = static_cast<bool>(child.getProperty(hiResPaths.front().prop, false));
+	}
 
-			auto& cc = ccBuf[i];
-			const auto pID = param::toPID(idStr);
-			cc.param.store(params[pID]);
+	if (const auto var = state.get(nrpnPath))
+	{
+		const auto entries = juce::StringArray::fromTokens(var->toString(), ",", "");
+		for (const auto& entry : entries)
+		{
+			const auto n = entry.upToFirstOccurrenceOf("=", false, false);
+			const auto pID = param::toPID(entry.fromFirstOccurrenceOf("=", false, false));
+			if (n.isNotEmpty() && pID != PID::NumParams)
+				mappings[NRPNOffset + n.getIntValue()] = static_cast<int>(pID);
 		}
 	}
+
+	unsaved = false;
+	publishTable();
 }
 
-void audio::MIDILearn::operator()(const MIDIBuf& midiBuf) noexcept
+void audio::MIDILearn::operator()(const MIDIBuf& midiBuf, int start, int end) noexcept
 {
+	const auto& table = tables.acquire();
+
+	/* only the latest value of each param matters */
+	std::array<float, NumParams> values;
+	std::array<int, NumParams> touched;
+	values.fill(-1.f);
+	auto numTouched = 0;
 	int c = -1;
+	LearnEvent learned = { -1, -1, false };
 
-	for (auto midi : midiBuf)
+	for (auto it = midiBuf.findNextSamplePosition(start); it != midiBuf.cend(); ++it)
 	{
+		const auto midi = *it;
+		if (midi.samplePosition >= end)
+			break;
 		auto msg = midi.getMessage();
+		if (!msg.isController())
+			continue;
 
-		if (msg.isController())
+		/* a controller sends its lsb right after the msb */
+		const auto cc = msg.getControllerNumber();
+		if (learned.controller != -1 && learned.controller < NumHiResCCs && cc == learned.controller + NumHiResCCs)
 		{
-			c = msg.getControllerNumber();
-			if (c < ccBuf.size())
-			{
-				auto& cc = ccBuf[c];
+			learned.hiRes = true;
+			continue;
+		}
+
+		auto value = 0.f;
+		const auto controller = decode(table, cc, msg.getControllerValue(), value);
+		if (controller == -1)
+			continue;
+		c = controller;
 
-				auto ap = assignableParam.load();
-				if (ap != nullptr)
-				{
-					cc.param.store(ap);
-					assignableParam.store(nullptr);
-				}
+		auto paramIdx = table(controller);
+		if (auto ap = assignableParam.exchange(nullptr))
+		{
+			paramIdx = static_cast<int>(ap->id);
+			learned = { controller, paramIdx, false };
+		}
+		if (paramIdx == -1)
+			continue;
+
+		if (values[paramIdx] == -1.f)
+			touched[numTouched++] = paramIdx;
+		values[paramIdx] = value;
+	}
 
-				cc.setValue(msg.getControllerValue());
-			}
+	if (learned.controller != -1)
+	{
+		int start1, size1, start2, size2;
+		learnFifo.prepareToWrite(1, start1, size1, start2, size2);
+		if (size1 != 0)
+		{
+			learnQueue[start1] = learned;
+			learnFifo.finishedWrite(1);
+		}
+	}
+
+	for (auto i = 0; i < numTouched; ++i)
+	{
+		const auto p = touched[i];
+		params[p]->setValue(values[p]);
+		hostValues[p].store(values[p]);
+		if (!hostPending[p].exchange(true))
+		{
+			int start1, size1, start2, size2;
+			hostFifo.prepareToWrite(1, start1, size1, start2, size2);
+			hostQueue[start1] = p;
+			hostFifo.finishedWrite(1);
 		}
 	}
 
@@ -89,12 +215,138 @@ void audio::MIDILearn::assignParam(Param* param) noexcept
 
 void audio::MIDILearn::removeParam(Param* param) noexcept
 {
-	for (auto& cc : ccBuf)
-		if (param == cc.param)
-			cc.param.store(nullptr);
+	const Lock lock(mappingLock);
+	const auto paramIdx = static_cast<int>(param->id);
+	for (auto it = mappings.begin(); it != mappings.end();)
+		if (it->second == paramIdx)
+		{
+			if (it->first < NumHiResCCs)
+				hiResMappings[it->first] = false;
+			it = mappings.erase(it);
+		}
+		else
+			++it;
+	unsaved = true;
+	publishTable();
 }
 
-audio::MIDILearn::String audio::MIDILearn::getIDString(int idx) const
+int audio::MIDILearn::decode(const Table& table, int cc, int value, float& valNorm) noexcept
 {
-	return "midilearn/cc" + String(idx);
+	switch (cc)
+	{
+	case 99: // nrpn msb
+		nrpnMSB = value;
+		return -1;
+	case 98: // nrpn lsb
+		nrpn = (nrpnMSB << 7) | value;
+		/* 127/127 is the null nrpn, which frees the data entry ccs again */
+		if (nrpn == 16383)
+			nrpn = -1;
+		return -1;
+	case 101: case 100: // rpns are not for us
+		nrpn = -1;
+		return -1;
+	case 6: // data entry msb
+		if (nrpn == -1)
+			break;
+		dataMSB = value;
+		/* 7-bit devices never send the lsb, so 127 has to reach 1 on its own */
+		valNorm = static_cast<float>(value) * ValInv;
+		return NRPNOffset + nrpn;
+	case 38: // data entry lsb
+		if (nrpn == -1)
+			break;
+		valNorm = static_cast<float>((dataMSB << 7) | value) * ValInv14;
+		return NRPNOffset + nrpn;
+	}
+
+	if (cc < NumHiResCCs)
+	{
+		msb[cc] = value;
+		/* the 14-bit value takes over once the lsb arrives */
+		valNorm = static_cast<float>(value) * ValInv;
+		return cc;
+	}
+	if (cc < 2 * NumHiResCCs && table.hiRes[cc - NumHiResCCs])
+	{
+		/* the lsb of a 14-bit cc */
+		const auto c = cc - NumHiResCCs;
+		valNorm = static_cast<float>((msb[c] << 7) | value) * ValInv14;
+		return c;
+	}
+	if (cc < NumCCs)
+	{
+		valNorm = static_cast<float>(value) * ValInv;
+		return cc;
+	}
+	return -1;
+}
+
+void audio::MIDILearn::publishTable()
+{
+	auto table = std::make_unique<Table>();
+	for (const auto& m : mappings)
+		if (m.first < NumCCs)
+		{
+			table->cc[m.first] = m.second;
+			if (m.first < NumHiResCCs)
+				table->hiRes[m.first] = hiResMappings[m.first];
+		}
+		else
+			table->nrpn.push_back({ m.first - NRPNOffset, m.second });
+	tables.publish(std::move(table));
+}
+
+void audio::MIDILearn::timerCallback()
+{
+	{
+		const Lock lock(mappingLock);
+		tables.collect();
+
+		const auto numLearned = learnFifo.getNumReady();
+		if (numLearned != 0)
+		{
+			int start1, size1, start2, size2;
+			learnFifo.prepareToRead(numLearned, start1, size1, start2, size2);
+			const auto learn = [&](const LearnEvent& e)
+			{
+				mappings[e.controller] = e.paramIdx;
+				if (e.controller < NumHiResCCs)
+					hiResMappings[e.controller] = e.hiRes;
+			};
+			for (auto i = 0; i < size1; ++i)
+				learn(learnQueue[start1 + i]);
+			for (auto i = 0; i < size2; ++i)
+				learn(learnQueue[start2 + i]);
+			learnFifo.finishedRead(size1 + size2);
+			unsaved = true;
+			publishTable();
+		}
+	}
+
+	const auto numReady = hostFifo.getNumReady();
+	if (numReady == 0)
+		return;
+
+	int start1, size1, start2, size2;
+	hostFifo.prepareToRead(numReady, start1, size1, start2, size2);
+	const auto flush = [&](int i)
+	{
+		const auto p = hostQueue[i];
+		/* clear first, so a value that comes in meanwhile gets queued again */
+		hostPending[p].store(false);
+		/* the audio thread has set the value already. writing it again from here
+		could undo a newer one, so the host only gets told about it */
+		auto param = params[p];
+		if (param->isInGesture())
+			return;
+		param->beginChangeGesture();
+		param->sendValueChangedMessageToListeners(hostValues[p].load());
+		param->endChangeGesture();
+	};
+	for (auto i = 0; i < size1; ++i)
+		flush(start1 + i);
+	for (auto i = 0; i < size2; ++i)
+		flush(start2 + i);
+	hostFifo.finishedRead(size1 + size2);
 }
\ No newline at end of file
@@ -1,53 +1,129 @@
 #pragma once
 #include <juce_core/juce_core.h>
 #include <juce_audio_basics/juce_audio_basics.h>
+#include <juce_events/juce_events.h>
 #include <array>
+#include <map>
+#include <vector>
+#include <algorithm>
 
 #include "../param/Param.h"
 #include "../arch/State.h"
+#include "EngineSwap.h"
 
 namespace audio
 {
-	class MIDILearn
+	/*
+	maps midi controllers to parameters. a controller is a cc or an nrpn.
+	ccs below 32 can be mapped as 14-bit, which happens when their lsb
+	(cc + 32) follows right away while they're learned. only then is the
+	lsb paired with them, otherwise ccs 32 to 63 are 7-bit controllers too.
+
+	the audio thread applies the latest value of each param per block directly.
+	the host gets told about it on the message thread, because gestures and
+	setValueNotifyingHost can be expensive and aren't realtime safe.
+	the controller to param table is rebuilt on the message thread whenever
+	the mappings change and handed to the audio thread with a pointer swap.
+	*/
+	class MIDILearn :
+		public juce::Timer
 	{
+	public:
+		static constexpr int NumCCs = 120;
+		/* controllers from here on are nrpns */
+		static constexpr int NRPNOffset = 128;
+
+	private:
 		using MIDIBuf = juce::MidiBuffer;
 		using Params = param::Params;
 		using State = sta::State;
 		using Param = param::Param;
 		using PID = param::PID;
 		using String = juce::String;
+		using Lock = juce::ScopedLock;
 
-		static constexpr float ValInv = 1.f / 128.f;
+		static constexpr int NumParams = param::NumParams;
+		static constexpr int FlushHz = 30;
+		static constexpr int NumHiResCCs = 32;
+		static constexpr int MaxLearnEvents = 16;
+		static constexpr float ValInv = 1.f / 127.f;
+		static constexpr float ValInv14 = 1.f / 16383.f;
 
-		struct CC
+		struct Table
 		{
-			CC();
+			Table();
 
-			void setValue(int);
+			/* returns the index of the param or -1 */
+			int operator()(int/*controller*/) const noexcept;
 
-			std::atomic<param::Param*> param;
+			std::array<int, NumCCs> cc;
+			/* ccs that are mapped as 14-bit */
+			std::array<bool, NumHiResCCs> hiRes;
+			/* nrpn and param, sorted by nrpn */
+			std::vector<std::pair<int, int>> nrpn;
+		};
+
+		struct LearnEvent
+		{
+			int controller, paramIdx;
+			bool hiRes;
 		};
 
 	public:
 		MIDILearn(Params&, State&);
 
-		void savePatch() const;
-		
+		/* only writes to the state if the mappings changed since the last time */
+		void savePatch();
+
 		void loadPatch();
 
-		void operator()(const MIDIBuf&) noexcept;
+		/* processes the ccs in [start, end) */
+		void operator()(const MIDIBuf&, int/*start*/, int/*end*/) noexcept;
 
 		void assignParam(param::Param*) noexcept;
-		
+
 		void removeParam(param::Param*) noexcept;
 
-		std::array<CC, 120> ccBuf;
+		/* the last controller that came in */
 		std::atomic<int> ccIdx;
 	protected:
 		std::atomic<param::Param*> assignableParam;
 		Params& params;
 		State& state;
+		/* midilearn/cc{i} -> id and hires, midilearn/nrpn -> map */
+		std::vector<State::Path> ccPaths, hiResPaths;
+		const State::Path nrpnPath;
+
+		/* controller to param index. only touched with the lock held */
+		std::map<int, int> mappings;
+		std::array<bool, NumHiResCCs> hiResMappings;
+		juce::CriticalSection mappingLock;
+		EngineSwap<Table> tables;
+		bool unsaved;
+
+		// AUDIO THREAD STATE:
+		std::array<int, NumHiResCCs> msb;
+		int nrpn, nrpnMSB, dataMSB;
+
+		/* the latest values the host doesn't know about yet */
+		std::array<std::atomic<float>, NumParams> hostValues;
+		std::array<std::atomic<bool>, NumParams> hostPending;
+		/* indexes of the params with a pending host notification. each one is in here at most
+		once, plus once more while the message thread flushes */
+		juce::AbstractFifo hostFifo;
+		std::array<int, 2 * NumParams + 1> hostQueue;
+
+		/* controllers the audio thread assigned to the assignable param */
+		juce::AbstractFifo learnFifo;
+		std::array<LearnEvent, MaxLearnEvents> learnQueue;
+
+		/* decodes 14-bit ccs and nrpns. returns the controller or -1 */
+		int decode(const Table&, int/*cc*/, int/*value*/, float&/*valNorm*/) noexcept;
+
+		/* rebuilds the table from the mappings. call with the lock held */
+		void publishTable();
 
-		String getIDString(int) const;
+		/* notifies the host about the pending values and takes over learned mappings */
+		void timerCallback() override;
 	};
 }
\ No newline at end of file
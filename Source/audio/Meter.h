@@ -68,6 +68,37 @@ namespace audio
 			process(vals[Type::Out], samples, numChannels, numSamples);
 		}
 
+#if PPDHasGainIn
+		/* for stages that meter while they write. see processRuns */
+		template<typename Process>
+		void processIn(int numChannels, int numSamples, Process&& process) noexcept
+		{
+			wHead(numSamples);
+
+			processRuns(vals[Type::In], numChannels, numSamples, process);
+		}
+#endif
+
+		/* for stages that meter while they write. see processRuns */
+		template<typename Process>
+		void processOut(int numChannels, int numSamples, Process&& process) noexcept
+		{
+#if !PPDHasGainIn
+			wHead(numSamples);
+#endif
+			processRuns(vals[Type::Out], numChannels, numSamples, process);
+		}
+
+		/* adds a sample to rect. stereo meters get the sum of both channels */
+		static float accumulate(float rect, float smpl) noexcept
+		{
+#if PPDMetersUseRMS
+			return rect + smpl * smpl;
+#else
+			return rect < smpl ? smpl : rect;
+#endif
+		}
+
 		const std::atomic<float>& operator()(int i) const noexcept
 		{
 			return vals[i].env;
@@ -82,106 +113,68 @@ namespace audio
 	private:
 		void process(Val& val, const float** samples, int numChannels, int numSamples) noexcept
 		{
-			auto& rect = val.rect;
-			auto& vVal = val.val;
-			auto& envFol = val.envFol;
-
-#if PPDMetersUseRMS
 			if (numChannels == 1)
 			{
-				auto smpls = samples[0];
-
+				const auto smpls = samples[0];
 
-				for (auto s = 0; s < numSamples; ++s)
+				processRuns(val, numChannels, numSamples, [smpls](int start, int end, float rect)
 				{
-					const auto w = wHead[s];
-
-					if (w == 0)
-					{
-						vVal = std::sqrt(rect * lenInv);
-						val.env.store(envFol.process(
-							vVal,
-							RiseInMs,
-							FallInMs
-						));
-
-						rect = 0.f;
-					}
-
-					const auto smpl = smpls[s];
-					rect += smpl * smpl;
-				}
+					for (auto s = start; s < end; ++s)
+						rect = accumulate(rect, smpls[s]);
+					return rect;
+				});
 			}
 			else
 			{
-				for (auto s = 0; s < numSamples; ++s)
-				{
-					const auto w = wHead[s];
-
-					if (w == 0)
-					{
-						vVal = std::sqrt(rect * lenInv) * .5f;
-						val.env.store(envFol.process(
-							vVal,
-							RiseInMs,
-							FallInMs
-						));
-
-						rect = 0.f;
-					}
-
-					const auto smpl = samples[0][s] + samples[1][s];
-					rect += smpl * smpl;
-				}
-			}
-#else
-			if (numChannels == 1)
-			{
-				const auto smpls = samples[0];
+				const auto smplsL = samples[0];
+				const auto smplsR = samples[1];
 
-				for (auto s = 0; s < numSamples; ++s)
+				processRuns(val, numChannels, numSamples, [smplsL, smplsR](int start, int end, float rect)
 				{
-					const auto w = wHead[s];
-
-					if (w == 0)
-					{
-						vVal = std::sqrt(rect);
-						val.env.store(envFol.process(
-							vVal,
-							RiseInMs,
-							FallInMs
-						));
-
-						rect = 0.f;
-					}
-
-					const auto smpl = smpls[s];
-					rect = rect < smpl ? smpl : rect;
-				}
+					for (auto s = start; s < end; ++s)
+						rect = accumulate(rect, smplsL[s] + smplsR[s]);
+					return rect;
+				});
 			}
-			else
+		}
+
+		/* splits the block where the meter updates. process(start, end, rect) has to
+		go through [start, end) and return rect with those samples accumulated */
+		template<typename Process>
+		void processRuns(Val& val, int numChannels, int numSamples, Process&& process) noexcept
+		{
+			for (auto s = 0; s < numSamples;)
 			{
-				for (auto s = 0; s < numSamples; ++s)
-				{
-					const auto w = wHead[s];
-
-					if (w == 0)
-					{
-						vVal = rect * .5f;
-						val.env.store(envFol.process(
-							vVal,
-							RiseInMs,
-							FallInMs
-						));
-
-						rect = 0.f;
-					}
-
-					const auto smpl = samples[0][s] + samples[1][s];
-					rect = rect < smpl ? smpl : rect;
-				}
+				const auto w = wHead[s];
+				if (w == 0)
+					update(val, numChannels);
+
+				const auto end = std::min(numSamples, s + length - w);
+				val.rect = process(s, end, val.rect);
+				s = end;
 			}
+		}
+
+		void update(Val& val, int numChannels) noexcept
+		{
+			auto& rect = val.rect;
+			auto& vVal = val.val;
+
+#if PPDMetersUseRMS
+			vVal = std::sqrt(rect * lenInv);
+#else
+			vVal = numChannels == 1 ? std::sqrt(rect) : rect;
 #endif
+			if (numChannels != 1)
+				vVal *= .5f;
+
+			val.env.store(val.envFol.process(
+				vVal,
+				RiseInMs,
+				FallInMs
+			));
+
+			rect = 0.f;
 		}
 	};
 }
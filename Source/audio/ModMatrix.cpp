@@ -0,0 +1,104 @@
+#include "ModMatrix.h"
+
+audio::ModMatrix::ModMatrix(State& _state) :
+	lfoRate(1.f),
+	envRise(5.f),
+	envFall(150.f),
+	velocity(0.f),
+	depths(),
+	unsaved(false),
+	state(_state),
+	depthPaths(),
+	ratePath("modmatrix/lfo", "rate"),
+	risePath("modmatrix/envfol", "rise"),
+	fallPath("modmatrix/envfol", "fall")
+{
+	depthPaths.reserve(NumSources * NumDests);
+	for (auto s = 0; s < NumSources; ++s)
+		for (auto d = 0; d < NumDests; ++d)
+			depthPaths.emplace_back(getIDString(static_cast<Source>(s), static_cast<Dest>(d)), "depth");
+	for (auto& src : depths)
+		for (auto& depth : src)
+			depth.store(0.f);
+}
+
+void audio::ModMatrix::savePatch()
+{
+	if (!unsaved.exchange(false))
+		return;
+
+	for (auto s = 0; s < NumSources; ++s)
+		for (auto d = 0; d < NumDests; ++d)
+		{
+			const auto depth = depths[s][d].load();
+			const auto& path = depthPaths[s * NumDests + d];
+			/* routes that got removed must be cleared too */
+			if (depth != 0.f || state.get(path) != nullptr)
+				state.set(path, depth, false);
+		}
+	state.set(ratePath, lfoRate.load(), false);
+	state.set(risePath, envRise.load(), false);
+	state.set(fallPath, envFall.load(), false);
+}
+
+void audio::ModMatrix::loadPatch()
+{
+	for (auto s = 0; s < NumSources; ++s)
+		for (auto d = 0; d < NumDests; ++d)
+		{
+			const auto var = state.get(depthPaths[s * NumDests + d]);
+			setDepth(static_cast<Source>(s), static_cast<Dest>(d), var ? static_cast<float>(*var) : 0.f);
+		}
+
+	if (const auto var = state.get(ratePath))
+		setLFORate(static_cast<float>(*var));
+	const auto rise = state.get(risePath);
+	const auto fall = state.get(fallPath);
+	if (rise && fall)
+		setEnvFol(static_cast<float>(*rise), static_cast<float>(*fall));
+	unsaved.store(false);
+}
+
+void audio::ModMatrix::setDepth(Source s, Dest d, float depth) noexcept
+{
+	depths[static_cast<int>(s)][static_cast<int>(d)].store(juce::jlimit(-1.f, 1.f, depth));
+	unsaved.store(true);
+}
+
+float audio::ModMatrix::getDepth(Source s, Dest d) const noexcept
+{
+	return depths[static_cast<int>(s)][static_cast<int>(d)].load();
+}
+
+void audio::ModMatrix::setLFORate(float hz) noexcept
+{
+	lfoRate.store(juce::jlimit(.01f, 40.f, hz));
+	unsaved.store(true);
+}
+
+void audio::ModMatrix::setEnvFol(float riseMs, float fallMs) noexcept
+{
+	envRise.store(juce::jmax(.1f, riseMs));
+	envFall.store(juce::jmax(.1f, fallMs));
+	unsaved.store(true);
+}
+
+void audio::ModMatrix::processMIDI(const MIDIBuf& midiBuf, int start, int end) noexcept
+{
+	for (auto it = midiBuf.findNextSamplePosition(start); it != midiBuf.cend(); ++it)
+	{
+		const auto midi = *it;
+		if (midi.samplePosition >= end)
+			break;
+		const auto msg = midi.getMessage();
+		if (msg.isNoteOn())
+			velocity = msg.getFloatVelocity();
+	}
+}
+
+audio::ModMatrix::String audio::ModMatrix::getIDString(Source s, Dest d)
+{
+	static constexpr std::array<const char*, NumSources> SourceIDs = { "lfo", "envfol", "macro", "velocity" };
+	static constexpr std::array<const char*, NumDests> DestIDs = { "grainsize", "tune", "feedback", "spreadtune" };
+	return "modmatrix/" + String(SourceIDs[static_cast<int>(s)]) + "/" + String(DestIDs[static_cast<int>(d)]);
+}
\ No newline at end of file
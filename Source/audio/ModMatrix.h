@@ -0,0 +1,188 @@
+#pragma once
+#include <juce_core/juce_core.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <array>
+#include <atomic>
+#include <vector>
+
+#include "../arch/State.h"
+#include "EnvelopeFollower.h"
+#include "Phasor.h"
+#include "PitchShifter.h"
+#include "PRM.h"
+
+namespace audio
+{
+	/*
+	routes modulation sources to the pitch shifter's parameters.
+	the routing lives in the state and can be changed from any thread.
+	every route's depth is in [-1,1] of its destination's MaxDepth.
+	*/
+	class ModMatrix
+	{
+		using MIDIBuf = juce::MidiBuffer;
+		using State = sta::State;
+		using String = juce::String;
+	public:
+		enum class Source { LFO, EnvFol, Macro, Velocity, NumSources };
+		static constexpr int NumSources = static_cast<int>(Source::NumSources);
+
+		enum class Dest { GrainSize, Tune, Feedback, SpreadTune, NumDests };
+		static constexpr int NumDests = static_cast<int>(Dest::NumDests);
+
+		/* ms, semitones, feedback, spread */
+		static constexpr std::array<float, NumDests> MaxDepth = { 500.f, 24.f, 1.f, 1.f };
+
+		ModMatrix(State&);
+
+		/* only writes to the state if the routing changed since the last time */
+		void savePatch();
+
+		void loadPatch();
+
+		// ANY THREAD:
+
+		void setDepth(Source, Dest, float/*[-1,1]*/) noexcept;
+
+		float getDepth(Source, Dest) const noexcept;
+
+		void setLFORate(float/*hz*/) noexcept;
+
+		void setEnvFol(float/*riseMs*/, float/*fallMs*/) noexcept;
+
+		std::atomic<float> lfoRate, envRise, envFall;
+
+		// AUDIO THREAD:
+
+		/* remembers the velocity of the last note-on in [start, end) */
+		void processMIDI(const MIDIBuf&, int/*start*/, int/*end*/) noexcept;
+
+		float velocity;
+
+	protected:
+		std::array<std::array<std::atomic<float>, NumDests>, NumSources> depths;
+		std::atomic<bool> unsaved;
+		State& state;
+		/* modmatrix/<source>/<dest> -> depth, indexed by source * NumDests + dest */
+		std::vector<State::Path> depthPaths;
+		const State::Path ratePath, risePath, fallPath;
+
+		static String getIDString(Source, Dest);
+	};
+
+	/*
+	renders the routed sources of one wet path and sums them into one
+	buffer per destination. sources are only rendered if a route with a
+	non-zero depth uses them.
+	*/
+	class Modulation
+	{
+		using Source = ModMatrix::Source;
+		using Dest = ModMatrix::Dest;
+		static constexpr int NumSources = ModMatrix::NumSources;
+		static constexpr int NumDests = ModMatrix::NumDests;
+	public:
+		using Mod = GranularPitchShifter::Mod;
+
+		Modulation() :
+			lfo(),
+			envFol(),
+			macroPRM(0.f),
+			velocityPRM(0.f),
+			sources(),
+			dests()
+		{}
+
+		void prepare(float Fs, int blockSize)
+		{
+			lfo.prepare(Fs, blockSize);
+			envFol.prepare(Fs);
+			macroPRM.prepare(Fs, blockSize, 20.f);
+			velocityPRM.prepare(Fs, blockSize, 20.f);
+			for (auto& src : sources)
+				src.resize(blockSize, 0.f);
+			for (auto& dest : dests)
+				dest.resize(blockSize, 0.f);
+		}
+
+		Mod operator()(const ModMatrix& matrix, const float* const* samples,
+			int numChannels, int numSamples, float macro) noexcept
+		{
+			std::array<std::array<float, NumDests>, NumSources> depths;
+			std::array<bool, NumSources> used;
+			for (auto s = 0; s < NumSources; ++s)
+			{
+				used[s] = false;
+				for (auto d = 0; d < NumDests; ++d)
+				{
+					depths[s][d] = matrix.getDepth(static_cast<Source>(s), static_cast<Dest>(d)) * ModMatrix::MaxDepth[d];
+					used[s] = used[s] || depths[s][d] != 0.f;
+				}
+			}
+
+			if (used[static_cast<int>(Source::LFO)])
+				renderLFO(numSamples, matrix.lfoRate.load());
+			if (used[static_cast<int>(Source::EnvFol)])
+				renderEnvFol(samples, numChannels, numSamples, matrix.envRise.load(), matrix.envFall.load());
+			if (used[static_cast<int>(Source::Macro)])
+				SIMD::copy(sources[static_cast<int>(Source::Macro)].data(), macroPRM(macro, numSamples), numSamples);
+			if (used[static_cast<int>(Source::Velocity)])
+				SIMD::copy(sources[static_cast<int>(Source::Velocity)].data(), velocityPRM(matrix.velocity, numSamples), numSamples);
+
+			std::array<const float*, NumDests> routed;
+			for (auto d = 0; d < NumDests; ++d)
+			{
+				routed[d] = nullptr;
+				auto dest = dests[d].data();
+				for (auto s = 0; s < NumSources; ++s)
+				{
+					const auto depth = depths[s][d];
+					if (depth == 0.f)
+						continue;
+					if (routed[d] == nullptr)
+						SIMD::multiply(dest, sources[s].data(), depth, numSamples);
+					else
+						SIMD::addWithMultiply(dest, sources[s].data(), depth, numSamples);
+					routed[d] = dest;
+				}
+			}
+
+			Mod mod;
+			mod.grainSize = routed[static_cast<int>(Dest::GrainSize)];
+			mod.tune = routed[static_cast<int>(Dest::Tune)];
+			mod.feedback = routed[static_cast<int>(Dest::Feedback)];
+			/* the spread changes the tune of every voice, so it's only block-rate */
+			if (const auto spread = routed[static_cast<int>(Dest::SpreadTune)])
+				mod.spreadTune = spread[numSamples - 1];
+			return mod;
+		}
+
+	protected:
+		PhasorBuffered<float> lfo;
+		EnvFol envFol;
+		PRM macroPRM, velocityPRM;
+		std::array<std::vector<float>, NumSources> sources;
+		std::array<std::vector<float>, NumDests> dests;
+
+		/* bipolar sine */
+		void renderLFO(int numSamples, float rateHz) noexcept
+		{
+			const auto phase = lfo.withHz(numSamples, rateHz);
+			auto src = sources[static_cast<int>(Source::LFO)].data();
+			for (auto s = 0; s < numSamples; ++s)
+				src[s] = std::sin(phase[s] * Tau);
+		}
+
+		/* envelope of the louder channel */
+		void renderEnvFol(const float* const* samples, int numChannels, int numSamples,
+			float riseMs, float fallMs) noexcept
+		{
+			auto src = sources[static_cast<int>(Source::EnvFol)].data();
+			SIMD::abs(src, samples[0], numSamples);
+			for (auto ch = 1; ch < numChannels; ++ch)
+				for (auto s = 0; s < numSamples; ++s)
+					src[s] = std::max(src[s], std::abs(samples[ch][s]));
+			envFol(src, src, numSamples, riseMs, fallMs);
+		}
+	};
+}
\ No newline at end of file
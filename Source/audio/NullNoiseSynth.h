@@ -3,7 +3,11 @@
 #include <juce_audio_processors/juce_audio_processors.h>
 #include <juce_events/juce_events.h>
 
+#include <array>
+#include <atomic>
 #include <cmath>
+#include <cstring>
+#include <limits>
 
 namespace audio
 {
@@ -11,108 +15,318 @@ namespace audio
 		public juce::HighResolutionTimer
 	{
 		using File = juce::File;
-		using UniqueStream = std::unique_ptr<juce::FileInputStream>;
+		using MappedFile = juce::MemoryMappedFile;
 		using SpecLoc = File::SpecialLocationType;
+		using uint8 = juce::uint8;
+		using uint32 = juce::uint32;
 
-		NullNoiseSynth() :
+		static constexpr int NoiseSize = 441;
+		static constexpr int FadeLength = 64;
+		static constexpr int NumTables = 4;
+		static constexpr int Fresh = 1 << 8;
+		static constexpr int IdxMask = Fresh - 1;
+		static constexpr int CacheMagic = 0x4e4e5332; // "NNS2"
+
+		/* scans the plugin binary on a background thread and outputs silence until
+		that's done. the scan result is cached next to the plugin's settings */
+		NullNoiseSynth(juce::ApplicationProperties& props) :
 			HighResolutionTimer(),
-			inputStream(File::getSpecialLocation(SpecLoc::currentApplicationFile).createInputStream()),
+			binary(File::getSpecialLocation(SpecLoc::currentApplicationFile)),
+			mapped(binary, MappedFile::readOnly),
+			cacheFolder(props.getUserSettings()->getFile().getParentDirectory()),
+			scanner(*this),
 			validPos(),
-			noise(),
+			tables(),
+			published(2),
+			ready(false),
+			front(0),
+			spare(1),
+			fadeFrom(0),
+			back(3),
 			writeHead(0),
 			readHead(0)
 		{
-			noise.reserve(441);
+			for (auto& table : tables)
+				table.resize(NoiseSize, 0.f);
+			scanner.startThread();
+		}
 
-			auto& stream = *inputStream.get();
+		~NullNoiseSynth()
+		{
+			scanner.stopThread(4000);
+			stopTimer();
+		}
 
-			validPos.reserve(1024);
-			
-			while (!stream.isExhausted())
+		void operator()(float** samples, int numChannels, int numSamples) noexcept
+		{
+			if (!ready.load())
 			{
-				const auto pos = stream.getPosition();
-				const auto smpl = stream.readFloatBigEndian();
-				if (!std::isnan(smpl) && !std::isinf(smpl))
-				{
-					if(smpl > -1.f && smpl < 1.f)
-					{
-						const auto absSmpl = std::abs(smpl);
-						if (absSmpl > .000001f)
-						{
-							validPos.push_back(static_cast<int>(pos));
-						}
-					}
-				}
+				for (auto ch = 0; ch < numChannels; ++ch)
+					juce::FloatVectorOperations::clear(samples[ch], numSamples);
+				return;
 			}
 
-			for (auto n = 0; n < noise.capacity(); ++n)
+			const auto fadeLength = pickUp(numSamples);
+			for (auto ch = 0; ch < numChannels; ++ch)
 			{
-				stream.setPosition(validPos[writeHead]);
+				auto smpls = samples[ch];
 
-				auto smpl = stream.readFloatBigEndian();
-				
-				noise.emplace_back(smpl);
+				render(smpls, numSamples, fadeLength);
+			}
+		}
 
-				++writeHead;
-				if (writeHead == validPos.size())
-					writeHead = 0;
+		void operator()(float* samples, int numSamples) noexcept
+		{
+			operator()(&samples, 1, numSamples);
+		}
+
+	protected:
+		struct Scanner :
+			public juce::Thread
+		{
+			Scanner(NullNoiseSynth& _synth) :
+				Thread("NullNoiseScanner"),
+				synth(_synth)
+			{}
+
+			void run() override
+			{
+				synth.initialize();
+			}
+
+			NullNoiseSynth& synth;
+		};
+
+		File binary;
+		MappedFile mapped;
+		File cacheFolder;
+		Scanner scanner;
+		std::vector<int> validPos;
+		/* the audio thread owns front and spare, the refill owns back.
+		the one in between is published, flagged with Fresh if it's new */
+		std::array<std::vector<float>, NumTables> tables;
+		std::atomic<int> published;
+		std::atomic<bool> ready;
+		int front, spare, fadeFrom, back;
+		int writeHead, readHead;
+
+		// SCANNER THREAD:
+
+		void initialize()
+		{
+			const auto data = static_cast<const uint8*>(mapped.getData());
+			const auto size = mapped.getSize();
+			if (data == nullptr || size < sizeof(float))
+				return;
+
+			/* the binary counts as unchanged if its path, size and time are.
+			hashing its content would read as much as the scan */
+			const auto key = getKey();
+			File cacheFile;
+			/* the settings folder only exists once the settings got saved */
+			if (cacheFolder != File() && cacheFolder.createDirectory().wasOk())
+				cacheFile = cacheFolder.getChildFile("nullnoise" + juce::String::toHexString(key.path.hashCode64()) + ".idx");
+
+			if (!loadIndex(cacheFile, key))
+			{
+				if (!scan(data, size))
+					return;
+				saveIndex(cacheFile, key);
 			}
+			if (validPos.empty())
+				return;
 
+			refill(tables[front]);
+			ready.store(true);
 			startTimer(static_cast<int>(1000.f / 25.f));
 		}
 
-		~NullNoiseSynth()
+		/* finds the big endian floats in (-1, 1) that aren't too close to 0 */
+		bool scan(const uint8* data, size_t size)
 		{
-			stopTimer();
+			static constexpr size_t ChunkSize = 1 << 16;
+			/* the absolute value's bits are in (lo, hi). nans and infs are bigger than hi */
+			const auto lo = toBits(.000001f);
+			const auto hi = toBits(1.f);
+
+			/* positions must fit into an int */
+			const auto numFloats = std::min(size, static_cast<size_t>(std::numeric_limits<int>::max())) / sizeof(float);
+			std::vector<uint8> valid(ChunkSize);
+			validPos.clear();
+			validPos.reserve(1024);
+
+			for (size_t i = 0; i < numFloats; i += ChunkSize)
+			{
+				if (scanner.threadShouldExit())
+					return false;
+
+				const auto n = std::min(ChunkSize, numFloats - i);
+				const auto chunk = data + i * sizeof(float);
+
+				/* branchless, so the compiler can vectorize it */
+				for (size_t j = 0; j < n; ++j)
+				{
+					const auto bits = juce::ByteOrder::bigEndianInt(chunk + j * sizeof(float)) & 0x7fffffff;
+					valid[j] = static_cast<uint8>(bits - lo - 1 < hi - lo - 1);
+				}
+
+				for (size_t j = 0; j < n; ++j)
+					if (valid[j])
+						validPos.push_back(static_cast<int>((i + j) * sizeof(float)));
+			}
+			return true;
 		}
 
-		void operator()(float** samples, int numChannels, int numSamples) noexcept
+		struct Key
 		{
-			for (auto ch = 0; ch < numChannels; ++ch)
+			bool operator==(const Key& other) const noexcept
 			{
-				auto smpls = samples[ch];
-				
-				operator()(smpls, numSamples);
+				return path == other.path && size == other.size && time == other.time;
 			}
+
+			juce::String path;
+			juce::int64 size, time;
+		};
+
+		Key getKey() const
+		{
+			return { binary.getFullPathName(), binary.getSize(), binary.getLastModificationTime().toMilliseconds() };
 		}
 
-		void operator()(float* samples, int numSamples) noexcept
+		bool loadIndex(const File& cacheFile, const Key& key)
 		{
-			auto smpls = samples;
+			if (!cacheFile.existsAsFile())
+				return false;
+			juce::MemoryBlock block;
+			if (!cacheFile.loadFileAsData(block))
+				return false;
 
-			for (auto s = 0; s < numSamples; ++s)
-			{
-				smpls[s] = noise[readHead];
+			juce::MemoryInputStream stream(block, false);
+			if (stream.readInt() != CacheMagic)
+				return false;
+			Key cached;
+			cached.path = stream.readString();
+			cached.size = stream.readInt64();
+			cached.time = stream.readInt64();
+			if (!(cached == key))
+				return false;
+			const auto num = stream.readInt();
+			if (num < 0 || static_cast<juce::int64>(sizeof(int)) * num != stream.getNumBytesRemaining())
+				return false;
 
-				++readHead;
-				if (readHead == noise.size())
-					readHead = 0;
+			validPos.resize(num);
+			stream.read(validPos.data(), num * static_cast<int>(sizeof(int)));
+
+			/* a broken file would make refill read outside of the binary */
+			const auto maxPos = static_cast<juce::int64>(mapped.getSize() - sizeof(float));
+			for (const auto pos : validPos)
+				if (pos < 0 || pos > maxPos)
+				{
+					validPos.clear();
+					return false;
+				}
+			return true;
+		}
+
+		void saveIndex(const File& cacheFile, const Key& key) const
+		{
+			if (cacheFile == File())
+				return;
+			/* other instances might be writing the same file right now */
+			juce::TemporaryFile tmp(cacheFile);
+			{
+				juce::FileOutputStream stream(tmp.getFile());
+				if (!stream.openedOk())
+					return;
+				stream.writeInt(CacheMagic);
+				stream.writeString(key.path);
+				stream.writeInt64(key.size);
+				stream.writeInt64(key.time);
+				stream.writeInt(static_cast<int>(validPos.size()));
+				stream.write(validPos.data(), validPos.size() * sizeof(int));
 			}
+			tmp.overwriteTargetFileWithTemporary();
 		}
 
-	protected:
-		UniqueStream inputStream;
-		std::vector<int> validPos;
-		std::vector<float> noise;
-		int writeHead, readHead;
+		static uint32 toBits(float x) noexcept
+		{
+			uint32 bits;
+			std::memcpy(&bits, &x, sizeof(float));
+			return bits;
+		}
 
-		void hiResTimerCallback() override
+		static float readFloat(const uint8* data) noexcept
 		{
-			auto& stream = *inputStream.get();
+			const auto bits = juce::ByteOrder::bigEndianInt(data);
+			float x;
+			std::memcpy(&x, &bits, sizeof(float));
+			return x;
+		}
+
+		// TIMER THREAD:
+
+		void refill(std::vector<float>& noise) noexcept
+		{
+			const auto data = static_cast<const uint8*>(mapped.getData());
 
 			for (auto n = 0; n < noise.size(); ++n)
 			{
-				stream.setPosition(validPos[writeHead]);
-
-				auto smpl = stream.readFloatBigEndian();
-				
-				noise[n] = smpl;
+				noise[n] = readFloat(data + validPos[writeHead]);
 
 				++writeHead;
 				if (writeHead == validPos.size())
 					writeHead = 0;
 			}
 		}
+
+		void hiResTimerCallback() override
+		{
+			refill(tables[back]);
+			back = published.exchange(back | Fresh) & IdxMask;
+		}
+
+		// AUDIO THREAD:
+
+		/* swaps in a fresh table, if there is one. returns the length of the crossfade */
+		int pickUp(int numSamples) noexcept
+		{
+			if ((published.load() & Fresh) == 0)
+				return 0;
+
+			/* the spare wasn't read since the last block, so the refill can have it.
+			the old front becomes the spare after this block's crossfade */
+			fadeFrom = front;
+			front = published.exchange(spare) & IdxMask;
+			spare = fadeFrom;
+			return std::min(numSamples, FadeLength);
+		}
+
+		void render(float* smpls, int numSamples, int fadeLength) noexcept
+		{
+			const auto& noise = tables[front];
+			const auto& prev = tables[fadeFrom];
+			/* the crossfade ends within the block, as the old table gets handed on after it */
+			const auto fadeInc = fadeLength == 0 ? 0.f : 1.f / static_cast<float>(fadeLength);
+
+			for (auto s = 0; s < fadeLength; ++s)
+			{
+				const auto x = static_cast<float>(s) * fadeInc;
+				smpls[s] = prev[readHead] + x * (noise[readHead] - prev[readHead]);
+
+				++readHead;
+				if (readHead == noise.size())
+					readHead = 0;
+			}
+
+			for (auto s = fadeLength; s < numSamples; ++s)
+			{
+				smpls[s] = noise[readHead];
+
+				++readHead;
+				if (readHead == noise.size())
+					readHead = 0;
+			}
+		}
 	};
 }
 
@@ -120,6 +334,4 @@ namespace audio
 
 this synth makes crappy noise from data that is used in a wrong way.
 it's a fun side project. contributions are welcome
-
-todo: save and load buffer indexes after first opened plugin
 */
\ No newline at end of file
@@ -1,9 +1,13 @@
 #pragma once
-#include "WHead.h"
+#include "../arch/SIMD.h"
+#include "RingBuffer.h"
+#include <algorithm>
 #include <array>
 #include <vector>
 #include <cmath>
 
+#include "../config.h"
+
 namespace audio
 {
 	struct ImpulseResponse
@@ -41,20 +45,20 @@ namespace audio
 	Nyquist == Fs / 2
 	fc < Nyquist
 	bw < Nyquist
-	fc + bw < Nyquist
+	fc + bw / 2 < Nyquist, as the transition band is centred on fc
 	*/
-	inline std::vector<float> makeWindowedSinc(float Fs, float fc, float bw, bool upsampling)
+	inline std::vector<float> makeWindowedSinc(float Fs, float fc, float bw, bool upsampling, int orderMultiple = 2)
 	{
 		const auto nyquist = Fs * .5f;
-		if (fc > nyquist || bw > nyquist || fc + bw > nyquist)
+		if (fc > nyquist || bw > nyquist || fc + bw * .5f > nyquist)
 			return {};
 
 		fc /= Fs;
 		bw /= Fs;
 
 		int M = static_cast<int>(4.f / bw);
-		if (M % 2 != 0)
-			M += 1; // M is even number
+		if (M % orderMultiple != 0)
+			M += orderMultiple - M % orderMultiple; // M is a multiple of orderMultiple
 
 		const auto Mf = static_cast<float>(M);
 		const auto MHalf = Mf * .5f;
@@ -104,234 +108,391 @@ namespace audio
 		return makeWindowedSinc(Fs, fc, Fs * .25f - fc - 1.f, upsampling);
 	}
 
-	struct Convolver
+	/* a kernel stored reversed and zero-padded to a multiple of the simd width,
+	so that it can be applied with one contiguous dot product */
+	struct Kernel
 	{
-		Convolver(const ImpulseResponse& _ir, const WHead& _wHead) :
-			ring(),
-			ir(_ir),
-			wHead(_wHead),
-			irSize(0)
+		Kernel() :
+			buf(),
+			size(0)
+		{}
+
+		static int getPaddedSize(int numTaps) noexcept
 		{
+			return (numTaps + vec::Width - 1) / vec::Width * vec::Width;
 		}
 
-		void prepare()
+		/* taps[i] is applied to the sample i samples ago */
+		void make(const std::vector<float>& taps, int paddedSize)
 		{
-			irSize = static_cast<int>(ir.size());
-			ring.setSize(2, irSize, false, true, false);
+			size = paddedSize;
+			buf.assign(size, 0.f);
+			for (auto i = 0; i < static_cast<int>(taps.size()); ++i)
+				buf[size - 1 - i] = taps[i];
 		}
 
-		void processBlock(float** samples, int numChannels, int numSamples) noexcept
+		/* x[size - 1] is the current sample */
+		float operator()(const float* x) const noexcept
+		{
+			auto y = vec::set(0.f);
+			for (auto i = 0; i < size; i += vec::Width)
+				y = vec::add(y, vec::mul(vec::load(&buf[i]), vec::load(&x[i])));
+			return vec::sum(y);
+		}
+
+		int getSize() const noexcept { return size; }
+
+	protected:
+		std::vector<float> buf;
+		int size;
+	};
+
+	/* the last samples of the previous block followed by the current block.
+	it's a mirrored ring, so firs can read it without wrapping any index
+	and the history doesn't have to be moved after each block */
+	struct LinearHistory
+	{
+		LinearHistory() :
+			rings(),
+			wHeads(),
+			length(0)
+		{}
+
+		void prepare(int _length, int blockSize)
+		{
+			length = _length;
+			for (auto& ring : rings)
+				ring.prepare(length - 1 + blockSize);
+			wHeads.fill(0);
+		}
+
+		/* the window of sample s starts at [s] */
+		const float* operator()(int ch, const float* smpls, int numSamples) noexcept
+		{
+			auto& ring = rings[ch];
+			const auto wHead = wHeads[ch];
+			ring.write(wHead, smpls, numSamples);
+
+			auto start = wHead - (length - 1);
+			if (start < 0)
+				start += ring.getSize();
+			return ring.data() + start;
+		}
+
+		void advance(int ch, int numSamples) noexcept
+		{
+			auto& wHead = wHeads[ch];
+			wHead += numSamples;
+			if (wHead >= rings[ch].getSize())
+				wHead -= rings[ch].getSize();
+		}
+
+	protected:
+		std::array<RingBuffer, 2> rings;
+		std::array<int, 2> wHeads;
+		int length;
+	};
+
+	/* zero-stuffing and filtering in one. the even and odd taps of the
+	impulse response make two phases, so no tap ever multiplies a zero */
+	struct PolyphaseUpsampler
+	{
+		PolyphaseUpsampler(const ImpulseResponse& _ir) :
+			ir(_ir),
+			phases(),
+			history()
+		{}
+
+		void prepare(int blockSize)
+		{
+			std::array<std::vector<float>, 2> taps;
+			for (auto i = 0; i < static_cast<int>(ir.size()); ++i)
+				taps[i % 2].push_back(ir[i]);
+
+			const auto size = Kernel::getPaddedSize(static_cast<int>(taps[0].size()));
+			for (auto p = 0; p < 2; ++p)
+				phases[p].make(taps[p], size);
+
+			history.prepare(size, blockSize);
+		}
+
+		void operator()(float** samplesUp, const float** samplesIn, int numChannels, int numSamples1x) noexcept
 		{
 			for (auto ch = 0; ch < numChannels; ++ch)
 			{
-				auto smpls = samples[ch];
-				auto rng = ring.getWritePointer(ch);
+				auto upBuf = samplesUp[ch];
+				const auto x = history(ch, samplesIn[ch], numSamples1x);
+
+				for (auto s = 0; s < numSamples1x; ++s)
+				{
+					const auto s2 = s * 2;
+					upBuf[s2] = phases[0](&x[s]);
+					upBuf[s2 + 1] = phases[1](&x[s]);
+				}
 
-				processBlock(smpls, rng, numSamples);
+				history.advance(ch, numSamples1x);
 			}
 		}
 
 	protected:
-		AudioBuffer ring;
 		const ImpulseResponse& ir;
-		const WHead& wHead;
-		int irSize;
+		std::array<Kernel, 2> phases;
+		LinearHistory history;
+	};
 
-	private:
-		void processBlock(float* smpls, float* rng, int numSamples) noexcept
+	/* filtering and decimating in one. only the samples that are
+	kept get computed */
+	struct DecimatingDownsampler
+	{
+		DecimatingDownsampler(const ImpulseResponse& _ir) :
+			ir(_ir),
+			kernel(),
+			history()
+		{}
+
+		void prepare(int blockSizeUp)
 		{
-			for (auto s = 0; s < numSamples; ++s)
-				smpls[s] = processSample(smpls[s], rng, wHead[s]);
+			std::vector<float> taps(ir.data(), ir.data() + ir.size());
+			kernel.make(taps, Kernel::getPaddedSize(static_cast<int>(taps.size())));
+
+			history.prepare(kernel.getSize(), blockSizeUp);
 		}
 
-		float processSample(float smpl, float* rng, int w) noexcept
+		void operator()(float** samplesOut, const float** samplesUp, int numChannels, int numSamples1x) noexcept
 		{
-			rng[w] = smpl;
-
-			auto y = 0.f;
-			auto r = w;
+			const auto numSamples2x = numSamples1x * 2;
 
-			for (auto i = 0; i < irSize; ++i)
+			for (auto ch = 0; ch < numChannels; ++ch)
 			{
-				y += rng[r] * ir[i];
-				--r;
-				if (r == -1)
-					r = irSize - 1;
-			}
+				auto outBuf = samplesOut[ch];
+				const auto x = history(ch, samplesUp[ch], numSamples2x);
+
+				for (auto s = 0; s < numSamples1x; ++s)
+					outBuf[s] = kernel(&x[s * 2]);
 
-			return y;
+				history.advance(ch, numSamples2x);
+			}
 		}
+
+	protected:
+		const ImpulseResponse& ir;
+		Kernel kernel;
+		LinearHistory history;
 	};
 
-	inline void zeroStuff(float** samplesUp, const float** samplesIn, int numChannels, int numSamples1x) noexcept
+	/* one 2x stage of the oversampling cascade */
+	struct OversamplingStage
 	{
-		for (auto ch = 0; ch < numChannels; ++ch)
+		OversamplingStage() :
+			buffer(),
+
+			irUp(),
+			irDown(),
+
+			filterUp(irUp),
+			filterDown(irDown),
+
+			latency(0)
+		{}
+
+		OversamplingStage(const OversamplingStage& other) :
+			buffer(other.buffer),
+			irUp(other.irUp),
+			irDown(other.irDown),
+			filterUp(irUp),
+			filterDown(irDown),
+			latency(other.latency)
+		{}
+
+		/*
+		idx: position in the cascade, Fs: base samplerate.
+		the first stage filters right below the base nyquist.
+		every later stage only has to remove the images of the
+		passband, so its transition band is much wider and its
+		kernel much shorter. filter orders are multiples of the
+		stage's factor, so their latency is an integer at Fs.
+		*/
+		void prepare(int idx, double Fs, int blockSizeIn, float cutoff)
 		{
-			auto upBuf = samplesUp[ch];
-			const auto inBuf = samplesIn[ch];
+			irUp = makeImpulseResponse(idx, Fs, cutoff, true);
+			irDown = makeImpulseResponse(idx, Fs, cutoff, false);
 
-			for (auto s = 0; s < numSamples1x; ++s)
-			{
-				const auto s2 = s * 2;
-				upBuf[s2] = inBuf[s];
-				upBuf[s2 + 1] = 0.f;
-			}
+			filterUp.prepare(blockSizeIn);
+			filterDown.prepare(blockSizeIn * 2);
+
+			buffer.setSize(2, blockSizeIn * 2, false, true, false);
+
+			latency = (irUp.getLatency() + irDown.getLatency()) >> (idx + 1);
 		}
-	}
 
-	inline void decimate(float** samplesOut, const float** samplesUp, int numChannels, int numSamples1x) noexcept
-	{
-		for (auto ch = 0; ch < numChannels; ++ch)
+		/* the latency the stage would have, without preparing it */
+		static int getLatency(int idx, double Fs, float cutoff)
+		{
+			const ImpulseResponse ir(makeImpulseResponse(idx, Fs, cutoff, true));
+			return (ir.getLatency() * 2) >> (idx + 1);
+		}
+
+		const float** upsample(const float** samplesIn, int numChannels, int numSamplesIn) noexcept
+		{
+			buffer.setSize(numChannels, numSamplesIn * 2, true, false, true);
+
+			filterUp(buffer.getArrayOfWritePointers(), samplesIn, numChannels, numSamplesIn);
+
+			return buffer.getArrayOfReadPointers();
+		}
+
+		void downsample(float** samplesOut, int numChannels, int numSamplesOut) noexcept
 		{
-			auto outBuf = samplesOut[ch];
-			const auto upBuf = samplesUp[ch];
+			filterDown(samplesOut, buffer.getArrayOfReadPointers(), numChannels, numSamplesOut);
+		}
+
+		/* in samples of the base samplerate */
+		int getLatency() const noexcept { return latency; }
 
-			for (auto s = 0; s < numSamples1x; ++s)
-				outBuf[s] = upBuf[s * 2];
+		AudioBuffer buffer;
+	protected:
+		ImpulseResponse irUp, irDown;
+		PolyphaseUpsampler filterUp;
+		DecimatingDownsampler filterDown;
+		int latency;
+
+	private:
+		static std::vector<float> makeImpulseResponse(int idx, double Fs, float cutoff, bool upsampling)
+		{
+			const auto factor = 1 << (idx + 1);
+			const auto FsUp = static_cast<float>(Fs * static_cast<double>(factor));
+			const auto FsIn = FsUp * .5f;
+			/* the later stages only have to keep their input's images out of
+			the passband, so their transition band is [cutoff, FsIn - cutoff] */
+			if (idx == 0)
+				return makeWindowedSinc(FsUp, cutoff, FsUp * .25f - cutoff - 1.f, upsampling, factor);
+			return makeWindowedSinc(FsUp, FsIn * .5f, FsIn - 2.f * cutoff, upsampling, factor);
 		}
-	}
+	};
 
 	class Oversampler
 	{
-		static constexpr float CutoffFreq = 18000.f;
+		static constexpr float CutoffFreq = 19000.f;
 	public:
+		static constexpr int MaxOrder = PPDOversamplingMaxOrder;
+
 		Oversampler() :
 			Fs(0.),
 			blockSize(0),
 
-			buffer(),
-
-			irUp(),
-			irDown(),
-			wHead(),
-
-			filterUp(irUp, wHead),
-			filterDown(irDown, wHead),
+			stages(),
 
 			FsUp(0.),
 			blockSizeUp(0),
 
-			numSamples1x(0), numSamples2x(0),
+			numSamples1x(0),
 
-			enabled(true)
+			order(1),
+			ordr(1)
 		{
 		}
 
 		Oversampler(Oversampler& other) :
 			Fs(other.Fs),
 			blockSize(other.blockSize),
-			buffer(other.buffer),
-			irUp(other.irUp),
-			irDown(other.irDown),
-			wHead(other.wHead),
-			filterUp(irUp, wHead),
-			filterDown(irDown, wHead),
+			stages(other.stages),
 			FsUp(other.FsUp),
 			blockSizeUp(other.blockSizeUp),
 			numSamples1x(other.numSamples1x),
-			numSamples2x(other.numSamples2x),
-			enabled(other.enabled.load()),
-			enbld(other.enbld)
+			order(other.order.load()),
+			ordr(other.ordr)
 		{}
 
 		void prepare(const double sampleRate, const int _blockSize)
 		{
-			enbld = isEnabled();
+			ordr = getOrder();
 
 			Fs = sampleRate;
 			blockSize = _blockSize;
 
-			if (enbld)
-			{
-				FsUp = Fs * 2.;
-				blockSizeUp = blockSize * 2;
-
-				irUp = makeWindowedSinc(static_cast<float>(FsUp), 19000.f, true);
-				irDown = makeWindowedSinc(static_cast<float>(FsUp), 19000.f, false);
-
-				filterUp.prepare();
-				filterDown.prepare();
+			FsUp = Fs;
+			blockSizeUp = blockSize;
 
-				buffer.setSize(2, blockSizeUp, false, true, false);
-				wHead.prepare(blockSizeUp, static_cast<int>(irDown.size()));
-			}
-			else
+			for (auto i = 0; i < ordr; ++i)
 			{
-				FsUp = Fs;
-				blockSizeUp = blockSize;
+				stages[i].prepare(i, Fs, blockSizeUp, CutoffFreq);
+				FsUp *= 2.;
+				blockSizeUp *= 2;
 			}
 		}
 
 		AudioBuffer& upsample(AudioBuffer& inputBuffer) noexcept
 		{
-			enbld = isEnabled();
-			if (enbld)
-			{
-				numSamples1x = inputBuffer.getNumSamples();
-				numSamples2x = numSamples1x * 2;
-				const auto numChannels = inputBuffer.getNumChannels();
-
-				buffer.setSize(numChannels, numSamples2x, true, false, true);
+			if (ordr == 0)
+				return inputBuffer;
 
-				auto samplesUp = buffer.getArrayOfWritePointers();
-				const auto samplesIn = inputBuffer.getArrayOfReadPointers();
+			numSamples1x = inputBuffer.getNumSamples();
+			const auto numChannels = inputBuffer.getNumChannels();
 
-				wHead(numSamples2x);
+			auto samples = inputBuffer.getArrayOfReadPointers();
+			auto numSamples = numSamples1x;
+			for (auto i = 0; i < ordr; ++i, numSamples *= 2)
+				samples = stages[i].upsample(samples, numChannels, numSamples);
 
-				zeroStuff(samplesUp, samplesIn, numChannels, numSamples1x);
-				filterUp.processBlock(samplesUp, numChannels, numSamples2x);
-
-				return buffer;
-			}
-			
-			return inputBuffer;
+			return stages[ordr - 1].buffer;
 		}
 
 		void downsample(AudioBuffer& outputBuffer) noexcept
 		{
-			if (enbld)
-			{
-				auto samplesUp = buffer.getArrayOfWritePointers();
-				auto samplesOut = outputBuffer.getArrayOfWritePointers();
-				const auto samplesUpConst = buffer.getArrayOfReadPointers();
-				const auto numChannels = outputBuffer.getNumChannels();
-
-				// filter 2x + decimating
-				filterDown.processBlock(samplesUp, numChannels, numSamples2x);
-				decimate(samplesOut, samplesUpConst, numChannels, numSamples1x);
-			}
+			if (ordr == 0)
+				return;
+
+			const auto numChannels = outputBuffer.getNumChannels();
+
+			auto numSamples = numSamples1x << (ordr - 1);
+			for (auto i = ordr - 1; i > 0; --i, numSamples /= 2)
+				stages[i].downsample(stages[i - 1].buffer.getArrayOfWritePointers(), numChannels, numSamples);
+
+			stages[0].downsample(outputBuffer.getArrayOfWritePointers(), numChannels, numSamples1x);
 		}
 
+		/* the summed group delay of all prepared stages */
 		const int getLatency() const noexcept
 		{
-			if(isEnabled())
-				return (irUp.getLatency() + irDown.getLatency()) / 2;
-			return 0;
+			auto latency = 0;
+			for (auto i = 0; i < ordr; ++i)
+				latency += stages[i].getLatency();
+			return latency;
 		}
+		/* the latency of the highest order at this samplerate */
+		static int getMaxLatency(double sampleRate)
+		{
+			auto latency = 0;
+			for (auto i = 0; i < MaxOrder; ++i)
+				latency += OversamplingStage::getLatency(i, sampleRate, CutoffFreq);
+			return latency;
+		}
+
 		double getFsUp() const noexcept { return FsUp; }
 		int getBlockSizeUp() const noexcept { return blockSizeUp; }
 
-		bool isEnabled() const noexcept { return enabled.load(); }
+		/* oversampling factor is 1 << order */
+		int getOrder() const noexcept { return order.load(); }
+
+		bool isEnabled() const noexcept { return getOrder() != 0; }
 
 		/* only call this if processor is suspended! */
-		void setEnabled(bool e) noexcept { enabled.store(e); }
+		void setOrder(int o) noexcept { order.store(juce::jlimit(0, MaxOrder, o)); }
 	protected:
 		double Fs;
 		int blockSize;
 
-		AudioBuffer buffer;
-
-		ImpulseResponse irUp, irDown;
-		WHead wHead;
-		Convolver filterUp, filterDown;
+		std::array<OversamplingStage, MaxOrder> stages;
 
 		double FsUp;
 		int blockSizeUp;
 
-		int numSamples1x, numSamples2x;
+		int numSamples1x;
 
-		std::atomic<bool> enabled;
-		bool enbld;
+		std::atomic<int> order;
+		int ordr;
 	};
 
-}
\ No newline at end of file
+}
+
+#include "../configEnd.h"
\ No newline at end of file
@@ -7,7 +7,8 @@ namespace audio
 	{
 		PRM(float startVal) :
 			smooth(startVal),
-			buf()
+			buf(),
+			smoothing(true)
 		{}
 
 		void prepare(float Fs, int blockSize, float smoothLenMs)
@@ -18,13 +19,14 @@ namespace audio
 
 		float* operator()(float value, int numSamples) noexcept
 		{
-			smooth(buf.data(), value, numSamples);
+			smoothing = smooth(buf.data(), value, numSamples);
 			return buf.data();
 		}
 
 		float* operator()(int numSamples) noexcept
 		{
 			smooth(buf.data(), numSamples);
+			smoothing = true;
 			return buf.data();
 		}
 
@@ -35,5 +37,7 @@ namespace audio
 
 		smooth::Smooth<float> smooth;
 		std::vector<float> buf;
+		/* false if the last block was constant */
+		bool smoothing;
 	};
 }
\ No newline at end of file
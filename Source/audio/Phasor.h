@@ -67,43 +67,45 @@ namespace audio
 
 		Float* withSecs(int numSamples, float freq) noexcept
 		{
-			for (auto s = 0; s < numSamples; ++s)
-			{
-				auto f = freqP(freq);
-				phasor.setFrequencySecs(f);
-				buffer[s] = phasor.process();
-			}
-
-			return buffer.data();
+			return process(numSamples, freq, [&p = phasor](Float f) { p.setFrequencySecs(f); });
 		}
 
 		Float* withMs(int numSamples, float freq) noexcept
 		{
-			for (auto s = 0; s < numSamples; ++s)
-			{
-				auto f = freqP(freq);
-				phasor.setFrequencyMs(f);
-				buffer[s] = phasor.process();
-			}
-
-			return buffer.data();
+			return process(numSamples, freq, [&p = phasor](Float f) { p.setFrequencyMs(f); });
 		}
 
 		Float* withHz(int numSamples, float freq) noexcept
 		{
-			for (auto s = 0; s < numSamples; ++s)
-			{
-				auto f = freqP(freq);
-				phasor.setFrequencyHz(f);
-				buffer[s] = phasor.process();
-			}
-
-			return buffer.data();
+			return process(numSamples, freq, [&p = phasor](Float f) { p.setFrequencyHz(f); });
 		}
 
 	protected:
 		Phasor<Float> phasor;
 		std::vector<Float> buffer;
 		PRM freqP;
+
+	private:
+		/* the frequency only gets recalculated while it is being smoothed */
+		template<typename SetFrequency>
+		Float* process(int numSamples, float freq, SetFrequency&& setFrequency) noexcept
+		{
+			const auto freqBuf = freqP(freq, numSamples);
+
+			if (!freqP.smoothing)
+			{
+				setFrequency(static_cast<Float>(freqBuf[0]));
+				for (auto s = 0; s < numSamples; ++s)
+					buffer[s] = phasor.process();
+				return buffer.data();
+			}
+
+			for (auto s = 0; s < numSamples; ++s)
+			{
+				setFrequency(static_cast<Float>(freqBuf[s]));
+				buffer[s] = phasor.process();
+			}
+			return buffer.data();
+		}
 	};
 }
\ No newline at end of file
@@ -1,9 +1,11 @@
 #pragma once
 #include "WHead.h"
 #include "Phasor.h"
+#include "RingBuffer.h"
 
 #include "PRM.h"
 #include "../arch/Interpolation.h"
+#include "../arch/SIMD.h"
 
 #include <array>
 #include "../config.h"
@@ -30,6 +32,8 @@ namespace audio
 				buf.resize(blockSize);
 			}
 
+			void reset() noexcept { phase = 0.f; }
+
 			void operator()(int numSamples) noexcept
 			{
 				for (auto s = 0; s < numSamples; ++s)
@@ -66,9 +70,10 @@ namespace audio
 			{
 				for (auto i = 0; i < TableSize; ++i)
 				{
-					const auto x = static_cast<float>(i) / static_cast<float>(table.size());
+					const auto x = static_cast<float>(i) / static_cast<float>(TableSize);
 					table[i] = std::cos(x * Tau + Pi) * .5f + .5f;
 				}
+				table[TableSize] = table[0];
 			}
 
 			void prepare(int blockSize)
@@ -81,14 +86,15 @@ namespace audio
 				for (auto s = 0; s < numSamples; ++s)
 				{
 					const auto idx = phasor[s] * tableSizeF;
-					buf[s] = interpolate::lerp(table.data(), idx, TableSize);
+					buf[s] = interpolate::lerp(table.data(), idx);
 				}
 			}
 
 			const float* data() const noexcept { return buf.data(); }
 
 		protected:
-			std::array<float, TableSize> table;
+			/* the last entry wraps around to the first */
+			std::array<float, TableSize + 1> table;
 			std::vector<float> buf;
 			float tableSizeF;
 		};
@@ -124,63 +130,142 @@ namespace audio
 			float sizeF;
 		};
 
+		/* shared input history of all voices. written once per sample,
+		read by every voice with its own read head and window.
+		the ring is mirrored, so interpolating across its end doesn't wrap */
 		struct Delay
 		{
 			Delay() :
-				ringBuffer(),
+				ringBuffer()
+			{
+			}
 
-				sizeF(0.f),
-				size(0)
+			/* the size can end up bigger than requested */
+			void prepare(int minSize)
 			{
+				for (auto& ring : ringBuffer)
+					ring.prepare(minSize);
 			}
 
-			void prepare(int _size)
+			int getSize() const noexcept { return ringBuffer[0].getSize(); }
+
+			void reset() noexcept
 			{
-				size = _size;
-				for (auto& ch : ringBuffer)
-					ch.resize(size + 4, 0.f);
+				for (auto& ring : ringBuffer)
+					ring.clear();
 			}
 
 			void operator()(float** samples, int numChannels, int numSamples,
-				const int* wHead, const float* readHead/*[0, size[*/,
-				const float* window, float feedback/*[-1,1]*/) noexcept
+				const int* wHead, const float* const* readHeads/*[0, size[*/,
+				const float* const* windows, int numVoices,
+				const float* feedback/*[-1,1]*/, float gain) noexcept
 			{
+				const auto numVoicesInv = 1.f / static_cast<float>(numVoices);
+
 				for (auto ch = 0; ch < numChannels; ++ch)
 				{
 					auto smpls = samples[ch];
-					auto ring = ringBuffer[ch].data();
+					auto& ringBuf = ringBuffer[ch];
+					const auto ring = ringBuf.data();
 
 					for (auto s = 0; s < numSamples; ++s)
 					{
-						const auto w = wHead[s];
-						const auto r = readHead[s];
-						const auto wndw = window[s];
+						auto sOut = 0.f;
+						for (auto v = 0; v < numVoices; ++v)
+							sOut += interpolate::lerp(ring, readHeads[v][s]) * windows[v][s];
+
+						ringBuf.write(wHead[s], smpls[s] + sOut * numVoicesInv * feedback[s]);
+						smpls[s] = sOut * gain;
+					}
+				}
+			}
+
+			/* voice-interleaved variant: voice v of sample s is at [s * stride + v].
+			the voices are read a vector at a time, so the windows of the lanes
+			from numVoices up to the next multiple of the vector width must be 0 */
+			void operator()(float** samples, int numChannels, int numSamples,
+				const int* wHead, const float* readHeads/*[0, size[*/,
+				const float* windows, int stride, int numVoices,
+				const float* feedback/*[-1,1]*/, float gain) noexcept
+			{
+				/* a gather of mostly empty lanes costs more than a few plain reads */
+				if (numVoices * 4 <= vec::Width)
+					return processScalar(samples, numChannels, numSamples, wHead, readHeads,
+						windows, stride, numVoices, feedback, gain);
+
+				const auto numVoicesInv = 1.f / static_cast<float>(numVoices);
+				const auto numLanes = (numVoices + vec::Width - 1) / vec::Width * vec::Width;
 
-						const auto sOut = interpolate::lerp(ring, r, size) * wndw;
-						const auto sIn = smpls[s] + sOut * feedback;
+				for (auto ch = 0; ch < numChannels; ++ch)
+				{
+					auto smpls = samples[ch];
+					auto& ringBuf = ringBuffer[ch];
+					const auto ring = ringBuf.data();
 
-						ring[w] = sIn;
-						smpls[s] = sOut;
+					for (auto s = 0; s < numSamples; ++s)
+					{
+						const auto rh = &readHeads[s * stride];
+						const auto wndw = &windows[s * stride];
+
+						/* lerp, with the read heads being positive */
+						auto sum = vec::set(0.f);
+						for (auto v = 0; v < numLanes; v += vec::Width)
+						{
+							const auto idx = vec::load(&rh[v]);
+							const auto iFloor = vec::truncate(idx);
+							const auto x = vec::sub(idx, vec::toFloat(iFloor));
+							const auto a = vec::gather(ring, iFloor);
+							const auto b = vec::gather(ring + 1, iFloor);
+							const auto y = vec::add(a, vec::mul(x, vec::sub(b, a)));
+							sum = vec::add(sum, vec::mul(y, vec::load(&wndw[v])));
+						}
+						const auto sOut = vec::sum(sum);
+
+						ringBuf.write(wHead[s], smpls[s] + sOut * numVoicesInv * feedback[s]);
+						smpls[s] = sOut * gain;
 					}
 				}
 			}
 
 		protected:
-			std::array<std::vector<float>, 2> ringBuffer;
+			std::array<RingBuffer, 2> ringBuffer;
 
-			float sizeF;
-			int size;
+			void processScalar(float** samples, int numChannels, int numSamples,
+				const int* wHead, const float* readHeads, const float* windows, int stride, int numVoices,
+				const float* feedback, float gain) noexcept
+			{
+				const auto numVoicesInv = 1.f / static_cast<float>(numVoices);
+
+				for (auto ch = 0; ch < numChannels; ++ch)
+				{
+					auto smpls = samples[ch];
+					auto& ringBuf = ringBuffer[ch];
+					const auto ring = ringBuf.data();
+
+					for (auto s = 0; s < numSamples; ++s)
+					{
+						const auto rh = &readHeads[s * stride];
+						const auto wndw = &windows[s * stride];
+
+						auto sOut = 0.f;
+						for (auto v = 0; v < numVoices; ++v)
+							sOut += interpolate::lerp(ring, rh[v]) * wndw[v];
+
+						ringBuf.write(wHead[s], smpls[s] + sOut * numVoicesInv * feedback[s]);
+						smpls[s] = sOut * gain;
+					}
+				}
+			}
 		};
 
+		/* the state of a single voice. it doesn't hold any audio,
+		only its read head and window into the shared delay */
 		struct Shifter
 		{
 			Shifter() :
-				audioBuffer(),
-
 				phasor(),
 				window(),
 				readHead(),
-				delay(),
 
 				tuneParam(0.f),
 
@@ -193,101 +278,301 @@ namespace audio
 			{
 				Fs = _Fs;
 
-				audioBuffer.setSize(2, blockSize, true, true, false);
-				
 				phasor.prepare(blockSize);
 				window.prepare(blockSize);
 				readHead.prepare(blockSize, static_cast<float>(size));
-				delay.prepare(size);
 
 				sizeInv = 1.f / static_cast<float>(size);
 
 				tuneParam.prepare(Fs, blockSize, 70.f);
 			}
 
-			void operator()(float** samples, int numChannels, int numSamples,
-				const int* wHead, const float* grainBuf,
-				float tune, float feedback) noexcept
-			{
-				for (auto ch = 0; ch < numChannels; ++ch)
-				{
-					auto buffer = audioBuffer.getWritePointer(ch);
-					const auto smpls = samples[ch];
-
-					SIMD::copy(buffer, smpls, numSamples);
-				}
+			void reset() noexcept { phasor.reset(); }
 
+			/* tuneRatio: per-sample factor of the tune, or nullptr */
+			void operator()(int numSamples, const int* wHead,
+				const float* grainBuf, bool grainSmoothing, float tune, const float* tuneRatio) noexcept
+			{
 				const auto tuneN = tune * Inv12;
 				const auto tuneBuf = tuneParam(std::pow(2.f, tuneN), numSamples);
 
-				for (auto s = 0; s < numSamples; ++s)
-					phasor.inc[s] = (1.f - tuneBuf[s]) / grainBuf[s];
+				if (tuneRatio != nullptr)
+					for (auto s = 0; s < numSamples; ++s)
+						phasor.inc[s] = (1.f - tuneBuf[s] * tuneRatio[s]) / grainBuf[s];
+				else if (tuneParam.smoothing || grainSmoothing)
+					for (auto s = 0; s < numSamples; ++s)
+						phasor.inc[s] = (1.f - tuneBuf[s]) / grainBuf[s];
+				else
+					SIMD::fill(phasor.inc.data(), (1.f - tuneBuf[0]) / grainBuf[0], numSamples);
 
 				phasor(numSamples);
 
 				window(phasor.data(), numSamples);
 
-				for (auto s = 0; s < numSamples; ++s)
-					phasor[s] *= grainBuf[s] * sizeInv;
+				if (grainSmoothing)
+					for (auto s = 0; s < numSamples; ++s)
+						phasor[s] *= grainBuf[s] * sizeInv;
+				else
+				{
+					const auto scale = grainBuf[0] * sizeInv;
+					for (auto s = 0; s < numSamples; ++s)
+						phasor[s] *= scale;
+				}
 
 				readHead(wHead, phasor.data(), numSamples);
+			}
 
-				delay
-				(
-					audioBuffer.getArrayOfWritePointers(),
-					numChannels,
-					numSamples,
-					wHead,
-					readHead.data(),
-					window.data(),
-					feedback
-				);
+			const float* getReadHead() const noexcept { return readHead.data(); }
+			const float* getWindow() const noexcept { return window.data(); }
+
+		protected:
+			Phasor phasor;
+			Window window;
+			ReadHead readHead;
+
+			PRM tuneParam;
+
+			float sizeInv, Fs;
+		};
+
+#if PPDPitchShifterVoiceSIMD
+		/* all voices in structure-of-arrays form. every per-sample step runs
+		over all lanes at once with SSE, AVX or NEON, and so does the
+		delay's read of all voices, so the cost doesn't depend on the number of
+		voices within a vector. inactive lanes are masked out, stay frozen, just
+		like unused Shifters do, and get a window of 0.
+		
+		compared to Shifter the results differ by less than 2e-4 of the
+		signal's peak (with the same fp-contraction settings), because the
+		hann window is evaluated with a polynomial instead of a table lookup.
+		phase and tune follow the exact same recurrences, so the error
+		doesn't accumulate over time. */
+		struct Voices
+		{
+			static constexpr int LaneWidth = 8;
+			static constexpr int NumLanes = (NumVoices + LaneWidth - 1) / LaneWidth * LaneWidth;
+			using Lanes = std::array<float, NumLanes>;
+
+			Voices() :
+				phase(),
+				tune(),
+				tuneDest(),
+				active(),
+
+				readHeadBuf(),
+				windowBuf(),
+
+				tuneA0(1.f),
+				tuneB1(0.f),
+				tuneEps(0.f),
+				sizeF(0.f)
+			{
+				phase.fill(0.f);
+				tune.fill(0.f);
+				tuneDest.fill(0.f);
+				active.fill(0.f);
 			}
 
-			void copyTo(float** samples, int numChannels, int numSamples) noexcept
+			void prepare(float Fs, int blockSize, int size)
 			{
-				for (auto ch = 0; ch < numChannels; ++ch)
-				{
-					const auto buffer = audioBuffer.getReadPointer(ch);
-					auto smpls = samples[ch];
+				readHeadBuf.resize(blockSize * NumLanes, 0.f);
+				windowBuf.resize(blockSize * NumLanes, 0.f);
 
-					SIMD::copy(smpls, buffer, numSamples);
-				}
+				tuneB1 = std::exp(-1.f / msInSamples(70.f, Fs));
+				tuneA0 = 1.f - tuneB1;
+				tuneEps = tuneA0 * 1.5f;
+				sizeF = static_cast<float>(size);
 			}
 
-			void addTo(float** samples, int numChannels, int numSamples) noexcept
+			/* all read heads start at the write head again */
+			void reset() noexcept
 			{
-				for (auto ch = 0; ch < numChannels; ++ch)
+				phase.fill(0.f);
+				tune = tuneDest;
+			}
+
+			void setTune(int v, float t) noexcept
+			{
+				tuneDest[v] = std::pow(2.f, t * Inv12);
+			}
+
+			void setNumVoices(int numVoices) noexcept
+			{
+				for (auto v = 0; v < NumLanes; ++v)
+					active[v] = v < numVoices ? 1.f : 0.f;
+			}
+
+			/* tuneRatio: per-sample factor of every voice's tune, or nullptr */
+			void operator()(int numSamples, const int* wHead, const float* grainBuf, bool grainSmoothing,
+				const float* tuneRatio) noexcept
+			{
+				if (tuneRatio == nullptr && !grainSmoothing && tuneConverged())
+					return processSteady(numSamples, wHead, grainBuf[0]);
+
+				const auto zero = vec::set(0.f);
+				const auto half = vec::set(.5f);
+				const auto one = vec::set(1.f);
+				const auto pi = vec::set(Pi);
+				const auto tuneA0V = vec::set(tuneA0);
+				const auto tuneB1V = vec::set(tuneB1);
+				const auto sizeV = vec::set(sizeF);
+
+				for (auto s = 0; s < numSamples; ++s)
 				{
-					const auto buffer = audioBuffer.getReadPointer(ch);
-					auto smpls = samples[ch];
+					const auto grain = grainBuf[s];
+					const auto w = static_cast<float>(wHead[s]);
+
+					auto rh = &readHeadBuf[s * NumLanes];
+					auto wndw = &windowBuf[s * NumLanes];
+
+					const auto wV = vec::set(w);
+					const auto grainV = vec::set(grain);
+					const auto ratioV = vec::set(tuneRatio != nullptr ? tuneRatio[s] : 1.f);
+
+					for (auto v = 0; v < NumLanes; v += vec::Width)
+					{
+						const auto isActive = vec::notEqual(vec::load(&active[v]), zero);
+
+						const auto tOld = vec::load(&tune[v]);
+						const auto t = vec::add(vec::mul(vec::load(&tuneDest[v]), tuneA0V), vec::mul(tOld, tuneB1V));
+						vec::store(&tune[v], vec::select(isActive, t, tOld));
+
+						const auto phs = vec::load(&phase[v]);
 
-					SIMD::add(smpls, buffer, numSamples);
+						const auto x = vec::mul(vec::sub(phs, half), pi);
+						const auto cos = cosHalfPi(vec::mul(x, x));
+						vec::store(&wndw[v], vec::mask(isActive, vec::mul(cos, cos)));
+
+						auto r = vec::sub(wV, vec::mul(phs, grainV));
+						r = vec::add(r, vec::mask(vec::lessThan(r, zero), sizeV));
+						vec::store(&rh[v], r);
+
+						auto p = vec::add(phs, vec::div(vec::sub(one, vec::mul(t, ratioV)), grainV));
+						p = vec::add(p, vec::mask(vec::lessThan(p, zero), one));
+						p = vec::sub(p, vec::mask(vec::greaterEqual(p, one), one));
+						vec::store(&phase[v], vec::select(isActive, p, phs));
+					}
 				}
 			}
 
+			const float* getReadHeads() const noexcept { return readHeadBuf.data(); }
+			const float* getWindows() const noexcept { return windowBuf.data(); }
+
 		protected:
-			AudioBuffer audioBuffer;
+			alignas(64) Lanes phase, tune, tuneDest, active;
+			std::vector<float> readHeadBuf, windowBuf;
+			float tuneA0, tuneB1, tuneEps, sizeF;
 
-			Phasor phasor;
-			Window window;
-			ReadHead readHead;
-			Delay delay;
+			/* snaps the tune of all active lanes to its destination, if they are close enough */
+			bool tuneConverged() noexcept
+			{
+				for (auto v = 0; v < NumLanes; ++v)
+					if (active[v] != 0.f && std::abs(tuneDest[v] - tune[v]) > tuneEps)
+						return false;
+				for (auto v = 0; v < NumLanes; ++v)
+					if (active[v] != 0.f)
+						tune[v] = tuneDest[v];
+				return true;
+			}
 
-			PRM tuneParam;
+			/* same as operator(), but with constant tune and grain size.
+			the phase increments only have to be computed once */
+			void processSteady(int numSamples, const int* wHead, float grain) noexcept
+			{
+				const auto zero = vec::set(0.f);
+				const auto half = vec::set(.5f);
+				const auto one = vec::set(1.f);
+				const auto pi = vec::set(Pi);
+				const auto sizeV = vec::set(sizeF);
+				const auto grainV = vec::set(grain);
+
+				alignas(64) Lanes inc;
+				for (auto v = 0; v < NumLanes; v += vec::Width)
+				{
+					const auto isActive = vec::notEqual(vec::load(&active[v]), zero);
+					const auto i = vec::div(vec::sub(one, vec::load(&tune[v])), grainV);
+					vec::store(&inc[v], vec::mask(isActive, i));
+				}
+				constexpr auto NumVecs = NumLanes / vec::Width;
+				vec::Mask isActive[NumVecs];
+				for (auto v = 0; v < NumVecs; ++v)
+					isActive[v] = vec::notEqual(vec::load(&active[v * vec::Width]), zero);
 
-			float sizeInv, Fs;
+				for (auto s = 0; s < numSamples; ++s)
+				{
+					const auto wV = vec::set(static_cast<float>(wHead[s]));
+
+					auto rh = &readHeadBuf[s * NumLanes];
+					auto wndw = &windowBuf[s * NumLanes];
+
+					for (auto v = 0; v < NumLanes; v += vec::Width)
+					{
+						const auto phs = vec::load(&phase[v]);
+
+						const auto x = vec::mul(vec::sub(phs, half), pi);
+						const auto cos = cosHalfPi(vec::mul(x, x));
+						vec::store(&wndw[v], vec::mask(isActive[v / vec::Width], vec::mul(cos, cos)));
+
+						auto r = vec::sub(wV, vec::mul(phs, grainV));
+						r = vec::add(r, vec::mask(vec::lessThan(r, zero), sizeV));
+						vec::store(&rh[v], r);
+
+						auto p = vec::add(phs, vec::load(&inc[v]));
+						p = vec::add(p, vec::mask(vec::lessThan(p, zero), one));
+						p = vec::sub(p, vec::mask(vec::greaterEqual(p, one), one));
+						vec::store(&phase[v], p);
+					}
+				}
+			}
+
+			/* cos(x) for x in [-pi/2, pi/2], taking x squared */
+			static vec::Vec cosHalfPi(vec::Vec xx) noexcept
+			{
+				auto y = vec::set(1.f / 40320.f);
+				y = vec::add(vec::set(-1.f / 720.f), vec::mul(xx, y));
+				y = vec::add(vec::set(1.f / 24.f), vec::mul(xx, y));
+				y = vec::add(vec::set(-1.f / 2.f), vec::mul(xx, y));
+				return vec::add(vec::set(1.f), vec::mul(xx, y));
+			}
 		};
+#endif
 
 	public:
+		/* per-sample offsets from the modulation matrix. nullptr if not modulated */
+		struct Mod
+		{
+			Mod() :
+				grainSize(nullptr),
+				tune(nullptr),
+				feedback(nullptr),
+				spreadTune(0.f)
+			{}
+
+			const float* grainSize; // ms
+			const float* tune; // semitones
+			const float* feedback;
+			float spreadTune;
+		};
+
 		GranularPitchShifter() :
 			wHead(),
 
+#if PPDPitchShifterVoiceSIMD
+			voices(),
+#else
 			shifter(),
+			readHeads(),
+			windows(),
+#endif
+			delay(),
 
 			grainParam(20.f),
+			tuneRatioBuf(),
+			feedbackBuf(),
 
-			Fs(0.f)
+			Fs(0.f),
+			grainMin(1.f),
+			grainMax(1.f)
 		{}
 
 		void prepare(float _Fs, int _blockSize)
@@ -295,64 +580,135 @@ namespace audio
 			Fs = _Fs;
 
 			const auto size = static_cast<int>(msInSamples(PPDPitchShifterSizeMs, Fs));
+
+			/* the read heads wrap at the ring's size, which can be bigger */
+			delay.prepare(size);
+			const auto ringSize = delay.getSize();
 			
-			wHead.prepare(_blockSize, size);
+			wHead.prepare(_blockSize, ringSize);
 
+#if PPDPitchShifterVoiceSIMD
+			voices.prepare(Fs, _blockSize, ringSize);
+#else
 			for(auto& s: shifter)
-				s.prepare(Fs, _blockSize, size);
+				s.prepare(Fs, _blockSize, ringSize);
+#endif
 
 			grainParam.prepare(Fs, _blockSize, 140.f);
+			tuneRatioBuf.resize(_blockSize);
+			feedbackBuf.resize(_blockSize);
+
+			grainMin = msInSamples(10.f, Fs);
+			grainMax = static_cast<float>(size - 1);
+		}
+
+		/* forgets all audio in the delay, so nothing old can be read again */
+		void reset() noexcept
+		{
+			delay.reset();
+#if PPDPitchShifterVoiceSIMD
+			voices.reset();
+#else
+			for (auto& s : shifter)
+				s.reset();
+#endif
 		}
 
 		void operator()(float** samples, int numChannels, int numSamples,
 			float tuneP/*[-24,24]*/, float grainSizeP/*[0, sizeF]*/, float feedbackP/*[0,1]*/,
-			int numVoicesP/*[1,NumVoices]*/, float spreadTuneP/*[0,1]*/) noexcept
+			int numVoicesP/*[1,NumVoices]*/, float spreadTuneP/*[0,1]*/, const Mod& mod = Mod()) noexcept
 		{
 			wHead(numSamples);
 
 			const auto grainBuf = grainParam(msInSamples(grainSizeP, Fs), numSamples);
+			auto grainSmoothing = grainParam.smoothing;
+			if (mod.grainSize != nullptr)
+			{
+				SIMD::addWithMultiply(grainBuf, mod.grainSize, msInSamples(1.f, Fs), numSamples);
+				SIMD::clip(grainBuf, grainBuf, grainMin, grainMax, numSamples);
+				grainSmoothing = true;
+			}
+
+			const float* tuneRatio = nullptr;
+			if (mod.tune != nullptr)
+			{
+				for (auto s = 0; s < numSamples; ++s)
+					tuneRatioBuf[s] = std::exp2(mod.tune[s] * Inv12);
+				tuneRatio = tuneRatioBuf.data();
+			}
+
+			SIMD::fill(feedbackBuf.data(), feedbackP, numSamples);
+			if (mod.feedback != nullptr)
+			{
+				SIMD::add(feedbackBuf.data(), mod.feedback, numSamples);
+				SIMD::clip(feedbackBuf.data(), feedbackBuf.data(), -1.f, 1.f, numSamples);
+			}
+
+			if (mod.spreadTune != 0.f)
+				spreadTuneP = juce::jlimit(0.f, 1.f, spreadTuneP + mod.spreadTune);
 
-			shifter[0]
+			const auto gain = 1.f / std::sqrt(static_cast<float>(numVoicesP));
+
+#if PPDPitchShifterVoiceSIMD
+			voices.setNumVoices(numVoicesP);
+			voices.setTune(0, tuneP);
+			for (auto i = 1; i < numVoicesP; ++i)
+				voices.setTune(i, tuneP + getSpreadTune(i, numVoicesP, spreadTuneP));
+
+			voices(numSamples, wHead.data(), grainBuf, grainSmoothing, tuneRatio);
+
+			delay
 			(
 				samples, numChannels, numSamples,
-				wHead.data(), grainBuf,
-				tuneP, feedbackP
+				wHead.data(), voices.getReadHeads(), voices.getWindows(),
+				Voices::NumLanes, numVoicesP,
+				feedbackBuf.data(), gain
 			);
+#else
+			shifter[0](numSamples, wHead.data(), grainBuf, grainSmoothing, tuneP, tuneRatio);
 
 			for (auto i = 1; i < numVoicesP; ++i)
-			{
-				auto& shftr = shifter[i];
-
-				const auto flip = i % 2 == 0 ? 1.f : -1.f;
-				const auto x = static_cast<float>(i) / numVoicesP;
-
-				const auto spreadTune = x * spreadTuneP * flip;
+				shifter[i](numSamples, wHead.data(), grainBuf, grainSmoothing, tuneP + getSpreadTune(i, numVoicesP, spreadTuneP), tuneRatio);
 
-				shftr
-				(
-					samples, numChannels, numSamples,
-					wHead.data(), grainBuf,
-					tuneP + spreadTune, feedbackP
-				);
+			for (auto i = 0; i < numVoicesP; ++i)
+			{
+				readHeads[i] = shifter[i].getReadHead();
+				windows[i] = shifter[i].getWindow();
 			}
 
-			shifter[0].copyTo(samples, numChannels, numSamples);
-			for(auto i = 1; i < numVoicesP; ++i)
-				shifter[i].addTo(samples, numChannels, numSamples);
-
-			const auto gain = 1.f / std::sqrt(static_cast<float>(numVoicesP));
-			for (auto ch = 0; ch < numChannels; ++ch)
-				SIMD::multiply(samples[ch], gain, numSamples);
+			delay
+			(
+				samples, numChannels, numSamples,
+				wHead.data(), readHeads.data(), windows.data(), numVoicesP,
+				feedbackBuf.data(), gain
+			);
+#endif
 		}
 
 	protected:
 		WHead wHead;
 		
+#if PPDPitchShifterVoiceSIMD
+		Voices voices;
+#else
 		std::array<Shifter, NumVoices> shifter;
+		std::array<const float*, NumVoices> readHeads, windows;
+#endif
+		Delay delay;
 
 		PRM grainParam;
+		std::vector<float> tuneRatioBuf, feedbackBuf;
+
+		float Fs, grainMin, grainMax;
 
-		float Fs;
+	private:
+		static float getSpreadTune(int i, int numVoicesP, float spreadTuneP) noexcept
+		{
+			const auto flip = i % 2 == 0 ? 1.f : -1.f;
+			const auto x = static_cast<float>(i) / numVoicesP;
+
+			return x * spreadTuneP * flip;
+		}
 	};
 }
 
@@ -360,8 +716,6 @@ namespace audio
 
 /*
 
-voice 1 need no copy to self buffer
-
 alter pitch per voice instead of grain size
 
 */
\ No newline at end of file
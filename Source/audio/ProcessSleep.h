@@ -0,0 +1,87 @@
+#pragma once
+#include <algorithm>
+
+namespace audio
+{
+	/*
+	lets the wet path sleep while there is nothing to process.
+
+	it falls asleep once the input and the wet output stayed below the
+	threshold for the hold time. the hold time has to be longer than the
+	time it takes the feedback to circulate through the grains once.
+	it wakes up on the first block with a signal in the input, before that
+	block gets processed, so no transient gets lost.
+	the delay still holds whatever came before the silence then. the
+	caller has to clear it on wake up, or a grain size that grew in the
+	meantime would read it again.
+	*/
+	class ProcessSleep
+	{
+		static constexpr float Threshold = .00001f; // -100db
+	public:
+		ProcessSleep() :
+			Fs(1.f),
+			latency(0),
+			silentSamples(0),
+			inputSilent(false),
+			sleeping(false),
+			woke(false)
+		{}
+
+		/* latency: of the wet path, in samples */
+		void prepare(float sampleRate, int _latency) noexcept
+		{
+			Fs = sampleRate;
+			latency = _latency;
+			silentSamples = 0;
+			inputSilent = false;
+			sleeping = false;
+			woke = false;
+		}
+
+		/* call with the input of the block. returns true if the wet path can be skipped */
+		bool operator()(const float* const* samples, int numChannels, int numSamples) noexcept
+		{
+			inputSilent = getPeak(samples, numChannels, numSamples) < Threshold;
+			woke = sleeping && !inputSilent;
+			if (!inputSilent)
+			{
+				silentSamples = 0;
+				sleeping = false;
+			}
+			return sleeping;
+		}
+
+		/* true if the last call ended the sleep */
+		bool wokeUp() const noexcept { return woke; }
+
+		/* call with the wet output of every block that got processed */
+		void processTail(const float* const* samples, int numChannels, int numSamples, float holdMs) noexcept
+		{
+			if (!inputSilent || getPeak(samples, numChannels, numSamples) >= Threshold)
+			{
+				silentSamples = 0;
+				return;
+			}
+
+			silentSamples += numSamples;
+			sleeping = static_cast<float>(silentSamples - latency) >= msInSamples(holdMs, Fs);
+		}
+
+	protected:
+		float Fs;
+		int latency, silentSamples;
+		bool inputSilent, sleeping, woke;
+
+		static float getPeak(const float* const* samples, int numChannels, int numSamples) noexcept
+		{
+			auto peak = 0.f;
+			for (auto ch = 0; ch < numChannels; ++ch)
+			{
+				const auto range = SIMD::findMinAndMax(samples[ch], numSamples);
+				peak = std::max(peak, std::max(range.getEnd(), -range.getStart()));
+			}
+			return peak;
+		}
+	};
+}
\ No newline at end of file
@@ -0,0 +1,147 @@
+#pragma once
+#include <juce_core/juce_core.h>
+#include <array>
+#include <atomic>
+
+#include "../config.h"
+
+#if PPDHasProfiler
+#define PGProfileScope(stage) const audio::Profiler::Scope profileScope##stage(profiler, audio::Profiler::Stage::stage)
+#else
+#define PGProfileScope(stage)
+#endif
+
+namespace audio
+{
+#if PPDHasProfiler
+	/*
+	measures how much of the realtime budget each stage of processBlock uses.
+	the audio thread is the only writer, the gui reads everything lock-free.
+	every block ends up in one histogram bin per stage.
+	*/
+	class Profiler
+	{
+		using Ticks = juce::int64;
+	public:
+		enum class Stage
+		{
+			MIDI,
+			DrySave,
+			Upsample,
+			Voices,
+			Downsample,
+			Output,
+			NumStages
+		};
+		static constexpr int NumStages = static_cast<int>(Stage::NumStages);
+
+		/* upper bin edges in percent of the block's duration. the last bin is open */
+		static constexpr int NumBins = 11;
+		static constexpr std::array<float, NumBins - 1> BinEdges = { .1f, .2f, .5f, 1.f, 2.f, 5.f, 10.f, 20.f, 50.f, 100.f };
+
+		struct Scope
+		{
+			Scope(Profiler& p, Stage s) noexcept :
+				profiler(p),
+				stage(s),
+				t0(juce::Time::getHighResolutionTicks())
+			{}
+
+			~Scope() noexcept
+			{
+				profiler.add(stage, juce::Time::getHighResolutionTicks() - t0);
+			}
+
+		protected:
+			Profiler& profiler;
+			Stage stage;
+			Ticks t0;
+		};
+
+		Profiler() :
+			histograms(),
+			means(),
+			elapsed(),
+			FsInv(1.),
+			percentPerTick(0.)
+		{
+			for (auto& h : histograms)
+				for (auto& b : h)
+					b.store(0);
+			for (auto& m : means)
+				m.store(0.f);
+		}
+
+		void prepare(double sampleRate) noexcept
+		{
+			FsInv = 1. / sampleRate;
+		}
+
+		// AUDIO THREAD:
+
+		void beginBlock(int numSamples) noexcept
+		{
+			elapsed.fill(0);
+			const auto secsPerBlock = static_cast<double>(numSamples) * FsInv;
+			percentPerTick = 100. / (secsPerBlock * static_cast<double>(juce::Time::getHighResolutionTicksPerSecond()));
+		}
+
+		void add(Stage s, Ticks t) noexcept
+		{
+			elapsed[static_cast<int>(s)] += t;
+		}
+
+		void endBlock() noexcept
+		{
+			for (auto s = 0; s < NumStages; ++s)
+			{
+				const auto percent = static_cast<float>(static_cast<double>(elapsed[s]) * percentPerTick);
+
+				auto bin = 0;
+				while (bin < NumBins - 1 && percent > BinEdges[bin])
+					++bin;
+				auto& count = histograms[s][bin];
+				count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+				auto& mean = means[s];
+				const auto m = mean.load(std::memory_order_relaxed);
+				mean.store(m + .05f * (percent - m), std::memory_order_relaxed);
+			}
+		}
+
+		// GUI THREAD:
+
+		/* number of blocks that fell into this bin so far */
+		int getCount(Stage s, int bin) const noexcept
+		{
+			return histograms[static_cast<int>(s)][bin].load(std::memory_order_relaxed);
+		}
+
+		/* smoothed average load of a stage in percent */
+		float getMean(Stage s) const noexcept
+		{
+			return means[static_cast<int>(s)].load(std::memory_order_relaxed);
+		}
+
+		static const char* getName(Stage s) noexcept
+		{
+			switch (s)
+			{
+			case Stage::MIDI: return "midi";
+			case Stage::DrySave: return "dry/latency";
+			case Stage::Upsample: return "upsample";
+			case Stage::Voices: return "voices";
+			case Stage::Downsample: return "downsample";
+			case Stage::Output: return "gain/meters/mix";
+			default: return "";
+			}
+		}
+
+	protected:
+		std::array<std::array<std::atomic<int>, NumBins>, NumStages> histograms;
+		std::array<std::atomic<float>, NumStages> means;
+		std::array<Ticks, NumStages> elapsed;
+		double FsInv, percentPerTick;
+	};
+#endif
+}
\ No newline at end of file
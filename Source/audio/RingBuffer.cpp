@@ -0,0 +1,227 @@
+#include "RingBuffer.h"
+#include <juce_core/juce_core.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+
+#if JUCE_WINDOWS
+#include <windows.h>
+#elif JUCE_LINUX || JUCE_MAC
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+audio::RingBuffer::RingBuffer() :
+	buf(nullptr),
+	mirror(nullptr),
+	fallback(),
+	size(0),
+	mapped(false)
+{}
+
+audio::RingBuffer::RingBuffer(const RingBuffer& other) :
+	RingBuffer()
+{
+	*this = other;
+}
+
+audio::RingBuffer& audio::RingBuffer::operator=(const RingBuffer& other)
+{
+	if (this == &other)
+		return *this;
+
+	if (other.size == 0)
+	{
+		unmap();
+		fallback.clear();
+		buf = mirror = nullptr;
+		size = 0;
+		return *this;
+	}
+
+	prepare(other.size);
+	write(0, other.buf, size);
+	return *this;
+}
+
+audio::RingBuffer::~RingBuffer()
+{
+	unmap();
+}
+
+void audio::RingBuffer::prepare(int minSize)
+{
+	unmap();
+
+	const auto granularity = getGranularity() / static_cast<int>(sizeof(float));
+	size = (std::max(minSize, 1) + granularity - 1) / granularity * granularity;
+
+	/* fresh mappings are zeroed by the os */
+	mapped = map(size * static_cast<int>(sizeof(float)));
+	if (mapped)
+		fallback.clear();
+	else
+	{
+		fallback.assign(2 * size, 0.f);
+		buf = fallback.data();
+	}
+	mirror = buf + size;
+}
+
+void audio::RingBuffer::write(int idx, const float* src, int numSamples) noexcept
+{
+	std::memcpy(buf + idx, src, numSamples * sizeof(float));
+	if (mapped)
+		return;
+
+	/* keeps the copy in sync. whatever went past the end belongs to the start */
+	const auto numHead = std::min(numSamples, size - idx);
+	std::memcpy(mirror + idx, src, numHead * sizeof(float));
+	if (numHead < numSamples)
+		std::memcpy(buf, src + numHead, (numSamples - numHead) * sizeof(float));
+}
+
+void audio::RingBuffer::clear() noexcept
+{
+	if (size == 0)
+		return;
+	std::memset(buf, 0, size * sizeof(float));
+	if (!mapped)
+		std::memset(mirror, 0, size * sizeof(float));
+}
+
+void audio::RingBuffer::read(float* dest, int idx, int numSamples) const noexcept
+{
+	std::memcpy(dest, buf + idx, numSamples * sizeof(float));
+}
+
+#if JUCE_WINDOWS
+
+bool audio::RingBuffer::map(int numBytes)
+{
+	const auto mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, static_cast<DWORD>(numBytes), nullptr);
+	if (mapping == nullptr)
+		return false;
+
+	/* finds a free region and maps into it, which can fail if another thread
+	allocates in between. the views keep the mapping alive */
+	for (auto attempt = 0; attempt < 8; ++attempt)
+	{
+		const auto region = VirtualAlloc(nullptr, 2 * static_cast<SIZE_T>(numBytes), MEM_RESERVE, PAGE_NOACCESS);
+		if (region == nullptr)
+			break;
+		VirtualFree(region, 0, MEM_RELEASE);
+
+		const auto a = MapViewOfFileEx(mapping, FILE_MAP_ALL_ACCESS, 0, 0, numBytes, region);
+		if (a == nullptr)
+			continue;
+		const auto b = MapViewOfFileEx(mapping, FILE_MAP_ALL_ACCESS, 0, 0, numBytes, static_cast<char*>(a) + numBytes);
+		if (b == nullptr)
+		{
+			UnmapViewOfFile(a);
+			continue;
+		}
+
+		CloseHandle(mapping);
+		buf = static_cast<float*>(a);
+		return true;
+	}
+
+	CloseHandle(mapping);
+	return false;
+}
+
+void audio::RingBuffer::unmap()
+{
+	if (!mapped)
+		return;
+	UnmapViewOfFile(buf + size);
+	UnmapViewOfFile(buf);
+	mapped = false;
+	buf = mirror = nullptr;
+}
+
+int audio::RingBuffer::getGranularity()
+{
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return static_cast<int>(info.dwAllocationGranularity);
+}
+
+#elif JUCE_LINUX || JUCE_MAC
+
+bool audio::RingBuffer::map(int numBytes)
+{
+#if JUCE_LINUX
+	const auto fd = memfd_create("RingBuffer", 0);
+#else
+	/* only the name has to be unique, it's gone right after */
+	static std::atomic<int> counter { 0 };
+	char name[32];
+	std::snprintf(name, sizeof(name), "/rb%d.%d", static_cast<int>(getpid()), counter.fetch_add(1));
+	const auto fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd != -1)
+		shm_unlink(name);
+#endif
+	if (fd == -1)
+		return false;
+	if (ftruncate(fd, numBytes) != 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	/* reserves both halves at once, so nothing else can end up in between */
+	const auto region = static_cast<char*>(mmap(nullptr, 2 * static_cast<size_t>(numBytes), PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+	if (region == MAP_FAILED)
+	{
+		close(fd);
+		return false;
+	}
+
+	const auto a = mmap(region, numBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+	const auto b = mmap(region + numBytes, numBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+	close(fd);
+	if (a != region || b != region + numBytes)
+	{
+		munmap(region, 2 * static_cast<size_t>(numBytes));
+		return false;
+	}
+
+	buf = reinterpret_cast<float*>(region);
+	return true;
+}
+
+void audio::RingBuffer::unmap()
+{
+	if (!mapped)
+		return;
+	munmap(buf, 2 * static_cast<size_t>(size) * sizeof(float));
+	mapped = false;
+	buf = mirror = nullptr;
+}
+
+int audio::RingBuffer::getGranularity()
+{
+	return static_cast<int>(sysconf(_SC_PAGESIZE));
+}
+
+#else
+
+bool audio::RingBuffer::map(int)
+{
+	return false;
+}
+
+void audio::RingBuffer::unmap()
+{
+}
+
+int audio::RingBuffer::getGranularity()
+{
+	return static_cast<int>(sizeof(float));
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,66 @@
+#pragma once
+#include <vector>
+
+namespace audio
+{
+	/*
+	a ring buffer whose storage is mirrored right behind itself, so that
+	data()[i + size] is data()[i] for i in [0, size). reads and writes can
+	cross the seam as one contiguous access, without wrapping any index.
+
+	the mirror is the same memory, mapped twice in a row. if the os doesn't
+	play along, it's a copy that every write keeps in sync.
+	the size gets rounded up to the granularity of the mapping.
+	*/
+	struct RingBuffer
+	{
+		RingBuffer();
+
+		RingBuffer(const RingBuffer&);
+
+		RingBuffer& operator=(const RingBuffer&);
+
+		~RingBuffer();
+
+		/* clears the buffer. never call this from the audio thread */
+		void prepare(int/*minSize*/);
+
+		int getSize() const noexcept { return size; }
+
+		/* zeroes the buffer, without any allocation */
+		void clear() noexcept;
+
+		/* true if the mirror is the os's mapping instead of a copy */
+		bool isMapped() const noexcept { return mapped; }
+
+		/* [0, 2 * size) can be read */
+		const float* data() const noexcept { return buf; }
+
+		/* idx in [0, size) */
+		void write(int idx, float x) noexcept
+		{
+			buf[idx] = x;
+			mirror[idx] = x;
+		}
+
+		/* idx in [0, size), numSamples <= size */
+		void write(int idx, const float* src, int numSamples) noexcept;
+
+		/* idx in [0, size), numSamples <= size */
+		void read(float* dest, int idx, int numSamples) const noexcept;
+
+	protected:
+		float* buf;
+		/* buf + size. the same memory as buf, if it's mapped */
+		float* mirror;
+		std::vector<float> fallback;
+		int size;
+		bool mapped;
+
+		bool map(int/*numBytes*/);
+
+		void unmap();
+
+		static int getGranularity();
+	};
+}
\ No newline at end of file
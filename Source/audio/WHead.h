@@ -1,4 +1,5 @@
 #pragma once
+#include <algorithm>
 #include <vector>
 
 namespace audio
@@ -21,10 +22,19 @@ namespace audio
 			}
 		}
 
+		/* counts up in runs between the wraps, so there's no modulo per sample */
 		void operator()(int numSamples) noexcept
 		{
-			for (auto s = 0; s < numSamples; ++s, wHead = (wHead + 1) % delaySize)
-				buf[s] = wHead;
+			for (auto s = 0; s < numSamples;)
+			{
+				const auto n = std::min(numSamples - s, delaySize - wHead);
+				for (auto i = 0; i < n; ++i)
+					buf[s + i] = wHead + i;
+				s += n;
+				wHead += n;
+				if (wHead == delaySize)
+					wHead = 0;
+			}
 		}
 
 		int operator[](int i) const noexcept { return buf[i]; }
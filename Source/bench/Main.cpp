@@ -0,0 +1,357 @@
+#include "../Processor.h"
+#include "../arch/Interpolation.h"
+
+#include <algorithm>
+#include <functional>
+#include <iostream>
+
+/*
+times the dsp primitives in isolation.
+
+usage:
+	PitchGlitcherBench [--filter <name>] [--quick] [--json <file>]
+
+every case gets swept over all block sizes and samplerates and reports
+the median and the best time per input sample of a few repetitions.
+--json writes the results to a file, or to stdout if the file is "-".
+*/
+
+namespace bench
+{
+	using String = juce::String;
+	using AudioBuffer = juce::AudioBuffer<float>;
+	using Process = std::function<void(AudioBuffer&)>;
+	using MakeProcess = std::function<Process(double/*Fs*/, int/*blockSize*/)>;
+
+	static constexpr int NumReps = 5;
+	static constexpr double SecondsPerRep = .25, SecondsWarmUp = .05;
+
+	struct Case
+	{
+		String name, args;
+		MakeProcess make;
+	};
+
+	struct Result
+	{
+		String name, args;
+		double Fs;
+		int blockSize;
+		double nsMedian, nsMin;
+	};
+
+	inline void fillNoise(AudioBuffer& buffer)
+	{
+		juce::Random rand(420);
+		for (auto ch = 0; ch < buffer.getNumChannels(); ++ch)
+		{
+			auto smpls = buffer.getWritePointer(ch);
+			for (auto s = 0; s < buffer.getNumSamples(); ++s)
+				smpls[s] = rand.nextFloat() * .5f - .25f;
+		}
+	}
+
+	inline void run(const Process& process, AudioBuffer& buffer, int numBlocks)
+	{
+		for (auto b = 0; b < numBlocks; ++b)
+			process(buffer);
+	}
+
+	inline Result measure(const Case& c, double Fs, int blockSize)
+	{
+		const juce::ScopedNoDenormals noDenormals;
+
+		AudioBuffer buffer(2, blockSize);
+		fillNoise(buffer);
+		const auto process = c.make(Fs, blockSize);
+
+		const auto blocksPerSecond = Fs / static_cast<double>(blockSize);
+		const auto numBlocksWarmUp = juce::jmax(1, static_cast<int>(blocksPerSecond * SecondsWarmUp));
+		const auto numBlocks = juce::jmax(8, static_cast<int>(blocksPerSecond * SecondsPerRep));
+		const auto numSamples = static_cast<double>(numBlocks) * static_cast<double>(blockSize);
+
+		run(process, buffer, numBlocksWarmUp);
+
+		std::array<double, NumReps> ns;
+		for (auto& n : ns)
+		{
+			const auto t0 = juce::Time::getHighResolutionTicks();
+			run(process, buffer, numBlocks);
+			const auto t1 = juce::Time::getHighResolutionTicks();
+			n = juce::Time::highResolutionTicksToSeconds(t1 - t0) * 1e9 / numSamples;
+		}
+		std::sort(ns.begin(), ns.end());
+
+		return { c.name, c.args, Fs, blockSize, ns[NumReps / 2], ns[0] };
+	}
+
+	inline std::vector<Case> makeCases()
+	{
+		using namespace audio;
+		std::vector<Case> cases;
+
+		for (auto numVoices : { 1, 2, 4, PPDPitchShifterNumVoices })
+			for (auto grainMs : { 5.f, 50.f, 500.f })
+				cases.push_back({ "pitchshifter", "voices=" + String(numVoices) + " grain=" + String(grainMs) + "ms",
+					[numVoices, grainMs](double Fs, int blockSize) -> Process
+					{
+						auto ps = std::make_shared<GranularPitchShifter>();
+						ps->prepare(static_cast<float>(Fs), blockSize);
+						return [ps, numVoices, grainMs](AudioBuffer& b)
+						{
+							(*ps)(b.getArrayOfWritePointers(), b.getNumChannels(), b.getNumSamples(),
+								7.f, grainMs, .5f, numVoices, .5f);
+						};
+					} });
+
+		for (auto order = 1; order <= Oversampler::MaxOrder; ++order)
+		{
+			const auto args = String(1 << order) + "x";
+			cases.push_back({ "oversampler.upsample", args,
+				[order](double Fs, int blockSize) -> Process
+				{
+					auto ovs = std::make_shared<Oversampler>();
+					ovs->setOrder(order);
+					ovs->prepare(Fs, blockSize);
+					return [ovs](AudioBuffer& b) { ovs->upsample(b); };
+				} });
+			cases.push_back({ "oversampler.downsample", args,
+				[order](double Fs, int blockSize) -> Process
+				{
+					auto ovs = std::make_shared<Oversampler>();
+					ovs->setOrder(order);
+					ovs->prepare(Fs, blockSize);
+					AudioBuffer in(2, blockSize);
+					ovs->upsample(in);
+					return [ovs](AudioBuffer& b) { ovs->downsample(b); };
+				} });
+		}
+
+		/* the 2x stage is what the old direct-form convolver did */
+		cases.push_back({ "polyphase.upsample", "2x",
+			[](double Fs, int blockSize) -> Process
+			{
+				auto stage = std::make_shared<OversamplingStage>();
+				stage->prepare(0, Fs, blockSize, 19000.f);
+				return [stage](AudioBuffer& b)
+				{
+					stage->upsample(b.getArrayOfReadPointers(), b.getNumChannels(), b.getNumSamples());
+				};
+			} });
+		cases.push_back({ "polyphase.downsample", "2x",
+			[](double Fs, int blockSize) -> Process
+			{
+				auto stage = std::make_shared<OversamplingStage>();
+				stage->prepare(0, Fs, blockSize, 19000.f);
+				return [stage](AudioBuffer& b)
+				{
+					stage->downsample(b.getArrayOfWritePointers(), b.getNumChannels(), b.getNumSamples());
+				};
+			} });
+
+		cases.push_back({ "drywetmix.saveDry", "",
+			[](double Fs, int blockSize) -> Process
+			{
+				auto mix = std::make_shared<DryWetMix>();
+				auto meters = std::make_shared<Meters>();
+				mix->prepare(static_cast<float>(Fs), blockSize, Oversampler::getMaxLatency(Fs));
+				meters->prepare(static_cast<float>(Fs), blockSize);
+				return [mix, meters](AudioBuffer& b)
+				{
+					mix->saveDry(b.getArrayOfWritePointers(), b.getNumChannels(), b.getNumSamples(),
+#if PPDHasGainIn
+						*meters, 0.f,
+#endif
+						.5f, 0.f
+#if PPDHasPolarity
+						, 1.f
+#endif
+#if PPDHasUnityGain
+						, 1.f
+#endif
+					);
+				};
+			} });
+		cases.push_back({ "drywetmix.processOut", "",
+			[](double Fs, int blockSize) -> Process
+			{
+				auto mix = std::make_shared<DryWetMix>();
+				auto meters = std::make_shared<Meters>();
+				mix->prepare(static_cast<float>(Fs), blockSize, 0);
+				meters->prepare(static_cast<float>(Fs), blockSize);
+				return [mix, meters](AudioBuffer& b)
+				{
+					mix->processOut(b.getArrayOfWritePointers(), b.getNumChannels(), b.getNumSamples(), *meters, false);
+				};
+			} });
+
+		cases.push_back({ "meters.processOut", "",
+			[](double Fs, int blockSize) -> Process
+			{
+				auto meters = std::make_shared<Meters>();
+				meters->prepare(static_cast<float>(Fs), blockSize);
+				return [meters](AudioBuffer& b)
+				{
+					meters->processOut(b.getArrayOfReadPointers(), b.getNumChannels(), b.getNumSamples());
+				};
+			} });
+
+		for (auto moving : { false, true })
+			cases.push_back({ "smooth", moving ? "moving" : "steady",
+				[moving](double Fs, int blockSize) -> Process
+				{
+					auto smooth = std::make_shared<Smooth>(0.f);
+					smooth->makeFromDecayInMs(20.f, static_cast<float>(Fs));
+					auto buf = std::make_shared<std::vector<float>>(blockSize);
+					auto dest = std::make_shared<float>(1.f);
+					return [smooth, buf, dest, moving](AudioBuffer& b)
+					{
+						if (moving)
+							*dest = 1.f - *dest;
+						(*smooth)(buf->data(), *dest, b.getNumSamples());
+					};
+				} });
+
+		cases.push_back({ "ramp", "moving",
+			[](double Fs, int blockSize) -> Process
+			{
+				auto ramp = std::make_shared<Ramp>(0.f);
+				ramp->makeFromLengthInMs(20.f, static_cast<float>(Fs));
+				auto buf = std::make_shared<std::vector<float>>(blockSize);
+				auto dest = std::make_shared<float>(1.f);
+				return [ramp, buf, dest](AudioBuffer& b)
+				{
+					*dest = 1.f - *dest;
+					(*ramp)(buf->data(), *dest, b.getNumSamples());
+				};
+			} });
+
+		for (auto cubic : { false, true })
+			cases.push_back({ cubic ? "interpolate.cubicHermiteSpline" : "interpolate.lerp", "",
+				[cubic](double Fs, int blockSize) -> Process
+				{
+					const auto size = static_cast<int>(Fs);
+					auto ring = std::make_shared<std::vector<float>>(size + 4, 0.f);
+					auto readHead = std::make_shared<float>(0.f);
+					return [ring, readHead, size, cubic](AudioBuffer& b)
+					{
+						const auto x = ring->data();
+						auto smpls = b.getWritePointer(0);
+						auto rh = *readHead;
+						for (auto s = 0; s < b.getNumSamples(); ++s)
+						{
+							smpls[s] = cubic ?
+								interpolate::cubicHermiteSpline(x, rh, size) :
+								interpolate::lerp(x, rh, size);
+							rh += 1.37f;
+							if (rh >= static_cast<float>(size))
+								rh -= static_cast<float>(size);
+						}
+						*readHead = rh;
+					};
+				} });
+
+		cases.push_back({ "interpolate.lerp.mirrored", "",
+			[](double Fs, int) -> Process
+			{
+				auto ring = std::make_shared<audio::RingBuffer>();
+				ring->prepare(static_cast<int>(Fs));
+				auto readHead = std::make_shared<float>(0.f);
+				return [ring, readHead](AudioBuffer& b)
+				{
+					const auto x = ring->data();
+					const auto sizeF = static_cast<float>(ring->getSize());
+					auto smpls = b.getWritePointer(0);
+					auto rh = *readHead;
+					for (auto s = 0; s < b.getNumSamples(); ++s)
+					{
+						smpls[s] = interpolate::lerp(x, rh);
+						rh += 1.37f;
+						if (rh >= sizeF)
+							rh -= sizeF;
+					}
+					*readHead = rh;
+				};
+			} });
+
+		return cases;
+	}
+
+	inline juce::var toJSON(const std::vector<Result>& results)
+	{
+		juce::Array<juce::var> arr;
+		for (const auto& r : results)
+		{
+			auto obj = new juce::DynamicObject();
+			obj->setProperty("name", r.name);
+			obj->setProperty("args", r.args);
+			obj->setProperty("sampleRate", r.Fs);
+			obj->setProperty("blockSize", r.blockSize);
+			obj->setProperty("nsPerSample", r.nsMedian);
+			obj->setProperty("nsPerSampleMin", r.nsMin);
+			arr.add(juce::var(obj));
+		}
+		return arr;
+	}
+
+	inline int run(const juce::ArgumentList& args)
+	{
+		const auto filter = args.getValueForOption("--filter");
+		const auto quick = args.containsOption("--quick");
+
+		std::vector<int> blockSizes;
+		std::vector<double> sampleRates;
+		if (quick)
+		{
+			blockSizes = { 512 };
+			sampleRates = { 48000. };
+		}
+		else
+		{
+			for (auto b = 16; b <= 4096; b *= 2)
+				blockSizes.push_back(b);
+			sampleRates = { 44100., 48000., 96000., 192000. };
+		}
+
+		std::vector<Result> results;
+		for (const auto& c : makeCases())
+		{
+			if (filter.isNotEmpty() && !c.name.contains(filter))
+				continue;
+
+			for (auto Fs : sampleRates)
+				for (auto blockSize : blockSizes)
+				{
+					results.push_back(measure(c, Fs, blockSize));
+					const auto& r = results.back();
+					std::cerr << r.name << " " << r.args << " @ " << Fs << "Hz, " << blockSize << ": "
+						<< r.nsMedian << " ns/sample (min " << r.nsMin << ")" << std::endl;
+				}
+		}
+
+		if (args.containsOption("--json"))
+		{
+			const auto json = juce::JSON::toString(toJSON(results));
+			const auto path = args.getValueForOption("--json");
+			if (path == "-")
+				std::cout << json << std::endl;
+			else if (!juce::File::getCurrentWorkingDirectory().getChildFile(path).replaceWithText(json))
+			{
+				std::cerr << "can't write " << path << std::endl;
+				return 1;
+			}
+		}
+
+		return 0;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const juce::ScopedJuceInitialiser_GUI juceInit;
+	const juce::ArgumentList args(argc, argv);
+	return juce::ConsoleApplication::invokeCatchingFailures([&args]()
+	{
+		return bench::run(args);
+	});
+}
\ No newline at end of file
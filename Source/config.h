@@ -8,12 +8,14 @@
 
 #define PPDHasGainIn false
 #define PPDHasHQ true
+#define PPDOversamplingMaxOrder 4
 #define PPDHasUnityGain false && PPDHasGainIn
 #define PPDHasStereoConfig false
 #define PPDHasPolarity false
 
 #define PPDEqualLoudnessMix true
 #define PPDHasMIDILearn true
+#define PPDAutomationGrid 32
 
 #define PPDFPSKnobs 30
 #define PPDFPSMeters 30.f
@@ -24,6 +26,8 @@
 
 #define PPDMetersUseRMS false
 
+#define PPDHasProfiler true
+
 #define PPD_GainIn_Min -12.f
 #define PPD_GainIn_Max 12.f
 #define PPD_GainOut_Min -24.f
@@ -33,4 +37,5 @@
 #define PPD_DebugFormularParser false
 
 #define PPDPitchShifterSizeMs 1000.f
-#define PPDPitchShifterNumVoices 7
\ No newline at end of file
+#define PPDPitchShifterNumVoices 7
+#define PPDPitchShifterVoiceSIMD true
\ No newline at end of file
@@ -1,10 +1,12 @@
 #undef PPDHasGainIn
 #undef PPDHasHQ
+#undef PPDOversamplingMaxOrder
 #undef PPDHasEditor
 #undef PPDEqualLoudnessMix
 #undef PPDFPSMeters
 #undef PPDFPSKnobs
 #undef PPDMetersUseRMS
+#undef PPDHasProfiler
 #undef PPD_GainIn_Min
 #undef PPD_GainIn_Max
 #undef PPD_GainOut_Min
@@ -18,8 +20,10 @@
 #undef PPDHasPatchBrowser
 #undef PPDPitchShifterSizeMs
 #undef PPDPitchShifterNumVoices
+#undef PPDPitchShifterVoiceSIMD
 #undef PPDHasStereoConfig
 #undef PPDHasPolarity
 #undef PPDEditorWidth
 #undef PPDEditorHeight
-#undef PPDHasMIDILearn
\ No newline at end of file
+#undef PPDHasMIDILearn
+#undef PPDAutomationGrid
\ No newline at end of file
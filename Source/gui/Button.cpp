@@ -134,6 +134,52 @@ void gui::Button::enableParameter(PID _pID, int val)
 	startTimerHz(24);
 }
 
+void gui::Button::enableParameterCycle(PID _pID)
+{
+	pID = _pID;
+
+	stopTimer();
+
+	onClick.push_back([param = utils.getParam(pID)]()
+	{
+		const auto& range = param->range;
+		auto v = std::rint(param->getValueDenorm()) + 1.f;
+		if (v > range.end)
+			v = range.start;
+		param->setValueWithGesture(range.convertTo0to1(v));
+	});
+
+	toggleState = -1;
+
+	onTimer.push_back([this]()
+		{
+			bool shallRepaint = false;
+
+			const auto param = utils.getParam(pID);
+
+			const auto lckd = param->isLocked();
+			if (locked != lckd)
+			{
+				locked = lckd;
+				label.textCID = locked ? ColourID::Inactive : ColourID::Interact;
+				shallRepaint = true;
+			}
+
+			const auto nTs = static_cast<int>(std::rint(param->getValueDenorm()));
+			if (toggleState != nTs)
+			{
+				toggleState = nTs;
+				label.setText(param->getText(param->getValue(), 0));
+				shallRepaint = true;
+			}
+
+			if (shallRepaint)
+				repaintWithChildren(this);
+		});
+
+	startTimerHz(24);
+}
+
 gui::Button::Button(Utils& _utils, String&& _tooltip) :
 	Comp(_utils, _tooltip),
 	onClick(),
@@ -535,6 +581,12 @@ void gui::makeParameterSwitchButton(Button& b, PID pID, ButtonSymbol symbol)
 	b.enableParameterSwitch(pID);
 }
 
+void gui::makeParameterCycleButton(Button& b, PID pID)
+{
+	makeTextButton(b, "", false);
+	b.enableParameterCycle(pID);
+}
+
 template<size_t NumButtons>
 void gui::makeParameterButtonsGroup(std::array<Button, NumButtons>& btns, PID pID, const char* txt, bool onlyText)
 {
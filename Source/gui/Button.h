@@ -35,6 +35,8 @@ namespace gui
 
 		void enableParameter(PID, int /*val*/);
 
+		void enableParameterCycle(PID);
+
 		Button(Utils&, String&& /*tooltip*/ = "");
 
 		Label& getLabel() noexcept;
@@ -88,6 +90,9 @@ namespace gui
 
 	void makeParameterSwitchButton(Button&, PID, ButtonSymbol);
 
+	// steps through all values of a stepped parameter and shows its value as text
+	void makeParameterCycleButton(Button&, PID);
+
 	template<size_t NumButtons>
 	void makeParameterButtonsGroup(std::array<Button, NumButtons>&, PID, const char* /*txt*/, bool /*onlyText*/);
 
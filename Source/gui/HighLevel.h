@@ -11,6 +11,7 @@
 #include "MIDICCMonitor.h"
 #endif
 #include "LowLevel.h"
+#include "ModMatrixPanel.h"
 
 #include "../config.h"
 
@@ -41,6 +42,7 @@ namespace gui
 #endif
 #if PPDHasHQ
 			hq(u, param::toTooltip(PID::HQ)),
+			hqFactor(u, param::toTooltip(PID::HQFactor)),
 #endif
 #if PPDHasStereoConfig
 			stereoConfig(u, param::toTooltip(PID::StereoConfig)),
@@ -54,6 +56,8 @@ namespace gui
 #endif
 
 			lowLevel(_lowLevel),
+			modMatrixPanel(u),
+			modMatrixButton(u, "Click here to open or close the modulation matrix."),
 
 			menu(nullptr),
 			menuButton(u, "Click here to open or close the panel with the advanced settings.")
@@ -89,6 +93,9 @@ namespace gui
 			makeParameterSwitchButton(hq, PID::HQ, "HQ");
 			hq.getLabel().mode = Label::Mode::TextToLabelBounds;
 			addAndMakeVisible(hq);
+			makeParameterCycleButton(hqFactor, PID::HQFactor);
+			hqFactor.getLabel().mode = Label::Mode::TextToLabelBounds;
+			addAndMakeVisible(hqFactor);
 #endif
 #if PPDHasStereoConfig
 			makeParameterSwitchButton(stereoConfig, PID::StereoConfig, ButtonSymbol::StereoConfig);
@@ -105,6 +112,17 @@ namespace gui
 			addAndMakeVisible(ccMonitor);
 #endif
 
+			makeTextButton(modMatrixButton, "Mod", true);
+			modMatrixButton.toggleState = 0;
+			modMatrixButton.onClick.push_back([this]()
+			{
+				auto& ts = modMatrixButton.toggleState;
+				ts = ts == 0 ? 1 : 0;
+				modMatrixPanel.setVisible(ts == 1);
+				repaintWithChildren(&modMatrixButton);
+			});
+			addAndMakeVisible(modMatrixButton);
+
 			makeSymbolButton(menuButton, ButtonSymbol::Settings);
 			menuButton.toggleState = 0;
 			menuButton.onClick.push_back([this]()
@@ -147,10 +165,11 @@ namespace gui
 
 		void init()
 		{
-#if PPDHasPatchBrowser
 			auto& pluginTop = utils.pluginTop;
+#if PPDHasPatchBrowser
 			pluginTop.addChildComponent(patchBrowser);
 #endif
+			pluginTop.addChildComponent(modMatrixPanel);
 		}
 
 		void paint(Graphics& g) override
@@ -188,6 +207,7 @@ namespace gui
 
 			layout.place(menuButton, 1.f, 1.f, 1.f, 1.f, true);
 			layout.place(parameterRandomizer, 7.f, 1.f, 1.f, 1.f, true);
+			layout.place(modMatrixButton, 3.f, 1.f, 3.f, 1.f, true);
 
 			layout.place(macro, 3.f, 3.f + patchBrowserOffset, 3.f, 1.f, true);
 			
@@ -210,13 +230,17 @@ namespace gui
 #if PPDHasStereoConfig
 			layout.place(stereoConfig, 5.f, 9.f + patchBrowserOffset, 1.f, 1.f, true);
 #endif
+#if PPDHasHQ
 			layout.place(hq, 7.f, 9.f + patchBrowserOffset, 1.f, 1.f, true);
+			layout.place(hqFactor, 7.f, 10.f + patchBrowserOffset, 1.f, 1.f, true);
+#endif
 #if PPDHasMIDILearn
 			layout.place(ccMonitor, 1.f, 10.f + patchBrowserOffset, 3.f, 1.f, false);
 #endif
 #if PPDHasPatchBrowser
 			patchBrowser.setBounds(lowLevel->getBounds());
 #endif
+			modMatrixPanel.setBounds(lowLevel->getBounds());
 
 			if (menu != nullptr)
 			{
@@ -243,7 +267,7 @@ namespace gui
 		Button unityGain;
 #endif
 #if PPDHasHQ
-		Button hq;
+		Button hq, hqFactor;
 #endif
 #if PPDHasStereoConfig
 		Button stereoConfig;
@@ -257,6 +281,8 @@ namespace gui
 #endif
 
 		LowLevel* lowLevel;
+		ModMatrixPanel modMatrixPanel;
+		Button modMatrixButton;
 		std::unique_ptr<Menu> menu;
 		Button menuButton;
 	};
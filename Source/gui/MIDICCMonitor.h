@@ -50,7 +50,9 @@ namespace gui
 
 		String toString()
 		{
-			return "cc: " + String(idx);
+			return idx < Learn::NRPNOffset ?
+				"cc: " + String(idx) :
+				"nrpn: " + String(idx - Learn::NRPNOffset);
 		}
 	};
 }
\ No newline at end of file
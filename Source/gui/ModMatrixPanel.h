@@ -0,0 +1,226 @@
+#pragma once
+#include "Comp.h"
+
+#include "../config.h"
+
+namespace gui
+{
+	/*
+	routes the mod matrix's sources to the pitch shifter.
+	a cell per route, drag it up or down to set the depth. the bottom row
+	sets the lfo's rate and the envelope follower's times.
+	double click a cell to reset it.
+	*/
+	struct ModMatrixPanel :
+		public Comp,
+		public Timer
+	{
+		using ModMatrix = audio::ModMatrix;
+		using Source = ModMatrix::Source;
+		using Dest = ModMatrix::Dest;
+		static constexpr int NumSources = ModMatrix::NumSources;
+		static constexpr int NumDests = ModMatrix::NumDests;
+		static constexpr int NumRoutes = NumSources * NumDests;
+		enum Setting { LFORate, EnvRise, EnvFall, NumSettings };
+
+		ModMatrixPanel(Utils& u) :
+			Comp(u, "Drag a route up or down to modulate a parameter with a source. Double click resets.", CursorType::Interact),
+			modMatrix(u.getModMatrix()),
+			dragIdx(-1),
+			dragStart(0.f)
+		{
+		}
+
+	protected:
+		ModMatrix& modMatrix;
+		int dragIdx;
+		float dragStart;
+
+		static const char* getName(Source s) noexcept
+		{
+			static constexpr std::array<const char*, NumSources> Names = { "LFO", "Envelope", "Macro", "Velocity" };
+			return Names[static_cast<int>(s)];
+		}
+
+		static const char* getName(Dest d) noexcept
+		{
+			static constexpr std::array<const char*, NumDests> Names = { "Grain Size", "Tune", "Feedback", "Spread Tune" };
+			return Names[static_cast<int>(d)];
+		}
+
+		static const char* getName(Setting s) noexcept
+		{
+			static constexpr std::array<const char*, NumSettings> Names = { "LFO Rate", "Env Rise", "Env Fall" };
+			return Names[s];
+		}
+
+		/* routes come first, then the settings */
+		float getValue(int idx) const noexcept
+		{
+			if (idx < NumRoutes)
+				return modMatrix.getDepth(static_cast<Source>(idx / NumDests), static_cast<Dest>(idx % NumDests));
+			switch (idx - NumRoutes)
+			{
+			case LFORate: return modMatrix.lfoRate.load();
+			case EnvRise: return modMatrix.envRise.load();
+			default: return modMatrix.envFall.load();
+			}
+		}
+
+		void setValue(int idx, float x) noexcept
+		{
+			if (idx < NumRoutes)
+				return modMatrix.setDepth(static_cast<Source>(idx / NumDests), static_cast<Dest>(idx % NumDests), x);
+			switch (idx - NumRoutes)
+			{
+			case LFORate: return modMatrix.setLFORate(x);
+			case EnvRise: return modMatrix.setEnvFol(x, modMatrix.envFall.load());
+			default: return modMatrix.setEnvFol(modMatrix.envRise.load(), x);
+			}
+		}
+
+		float getDefault(int idx) const noexcept
+		{
+			if (idx < NumRoutes)
+				return 0.f;
+			switch (idx - NumRoutes)
+			{
+			case LFORate: return 1.f;
+			case EnvRise: return 5.f;
+			default: return 150.f;
+			}
+		}
+
+		String getText(int idx) const
+		{
+			const auto x = getValue(idx);
+			if (idx < NumRoutes)
+				return x == 0.f ? String("-") : String(std::rint(x * 100.f)) + " %";
+			if (idx - NumRoutes == LFORate)
+				return String(x, 2) + " hz";
+			return String(x, 1) + " ms";
+		}
+
+		// LAYOUT: a header row, a row per source and a row for the settings.
+
+		BoundsF getArea() const noexcept
+		{
+			return getLocalBounds().toFloat().reduced(utils.thicc * 4.f);
+		}
+
+		BoundsF getCell(int col, int row) const noexcept
+		{
+			const auto area = getArea();
+			const auto w = area.getWidth() / static_cast<float>(NumDests + 1);
+			const auto h = area.getHeight() / static_cast<float>(NumSources + 3);
+			return { area.getX() + w * static_cast<float>(col), area.getY() + h * static_cast<float>(row), w, h };
+		}
+
+		BoundsF getCell(int idx) const noexcept
+		{
+			if (idx < NumRoutes)
+				return getCell(idx % NumDests + 1, idx / NumDests + 1);
+			return getCell(idx - NumRoutes + 1, NumSources + 2);
+		}
+
+		int getIdx(PointF pos) const noexcept
+		{
+			for (auto i = 0; i < NumRoutes + NumSettings; ++i)
+				if (getCell(i).contains(pos))
+					return i;
+			return -1;
+		}
+
+		void visibilityChanged() override
+		{
+			/* the routing can change with a loaded patch */
+			if (isVisible())
+			{
+				repaint();
+				startTimerHz(6);
+			}
+			else
+				stopTimer();
+		}
+
+		void timerCallback() override
+		{
+			if (dragIdx == -1)
+				repaint();
+		}
+
+		void mouseDown(const Mouse& mouse) override
+		{
+			dragIdx = getIdx(mouse.position);
+			if (dragIdx != -1)
+				dragStart = getValue(dragIdx);
+		}
+
+		void mouseDrag(const Mouse& mouse) override
+		{
+			if (dragIdx == -1)
+				return;
+			const auto speed = mouse.mods.isShiftDown() ? .1f : 1.f;
+			const auto dist = -static_cast<float>(mouse.getDistanceFromDragStartY()) * speed / getCell(dragIdx).getHeight();
+			/* depths are linear, times and rates are exponential */
+			if (dragIdx < NumRoutes)
+				setValue(dragIdx, dragStart + dist * .25f);
+			else
+				setValue(dragIdx, dragStart * std::exp2(dist * .5f));
+			repaint();
+		}
+
+		void mouseUp(const Mouse& mouse) override
+		{
+			dragIdx = -1;
+			Comp::mouseUp(mouse);
+		}
+
+		void mouseDoubleClick(const Mouse& mouse) override
+		{
+			const auto idx = getIdx(mouse.position);
+			if (idx == -1)
+				return;
+			setValue(idx, getDefault(idx));
+			repaint();
+		}
+
+		void paint(Graphics& g) override
+		{
+			g.fillAll(Colours::c(ColourID::Bg).withAlpha(.9f));
+
+			const auto thicc = utils.thicc;
+			g.setFont(getFontDosisMedium());
+
+			g.setColour(Colours::c(ColourID::Hover));
+			for (auto d = 0; d < NumDests; ++d)
+				g.drawFittedText(getName(static_cast<Dest>(d)), getCell(d + 1, 0).toNearestInt(), Just::centred, 1);
+			for (auto s = 0; s < NumSources; ++s)
+				g.drawFittedText(getName(static_cast<Source>(s)), getCell(0, s + 1).toNearestInt(), Just::centredLeft, 1);
+			for (auto s = 0; s < NumSettings; ++s)
+				g.drawFittedText(getName(static_cast<Setting>(s)), getCell(s + 1, NumSources + 1).toNearestInt(), Just::centred, 1);
+
+			for (auto i = 0; i < NumRoutes + NumSettings; ++i)
+			{
+				const auto cell = getCell(i).reduced(thicc);
+				g.setColour(Colours::c(ColourID::Hover));
+				g.drawRoundedRectangle(cell, thicc, thicc);
+
+				/* bipolar bar from the centre */
+				if (i < NumRoutes)
+				{
+					const auto depth = getValue(i);
+					const auto centreX = cell.getCentreX();
+					const auto w = cell.getWidth() * .5f * std::abs(depth);
+					g.setColour(Colours::c(ColourID::Mod));
+					g.fillRect(depth < 0.f ? centreX - w : centreX, cell.getBottom() - thicc * 2.f, w, thicc);
+				}
+
+				g.setColour(Colours::c(i == dragIdx ? ColourID::Interact : ColourID::Txt));
+				g.drawFittedText(getText(i), cell.toNearestInt(), Just::centred, 1);
+			}
+		}
+	};
+}
+
+#include "../configEnd.h"
\ No newline at end of file
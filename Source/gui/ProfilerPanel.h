@@ -0,0 +1,123 @@
+#pragma once
+#include "Comp.h"
+
+#include "../config.h"
+
+#if PPDHasProfiler
+namespace gui
+{
+	/* shows how much of the realtime budget each stage of the dsp takes */
+	struct ProfilerPanel :
+		public Comp,
+		public Timer
+	{
+		using Profiler = audio::Profiler;
+		using Stage = Profiler::Stage;
+		static constexpr int NumStages = Profiler::NumStages;
+		static constexpr int NumBins = Profiler::NumBins;
+		using Histogram = std::array<int, NumBins>;
+
+		ProfilerPanel(Utils& u) :
+			Comp(u, "Shows how much of the realtime budget each dsp stage takes. Click to close.", CursorType::Default),
+			profiler(u.getProfiler()),
+			counts(),
+			window()
+		{
+			for (auto& c : counts)
+				c.fill(0);
+			for (auto& w : window)
+				w.fill(0);
+		}
+
+	protected:
+		const Profiler& profiler;
+		/* counts since the plugin was loaded and since the last update */
+		std::array<Histogram, NumStages> counts, window;
+
+		void visibilityChanged() override
+		{
+			if (isVisible())
+			{
+				timerCallback();
+				startTimerHz(6);
+			}
+			else
+				stopTimer();
+		}
+
+		void timerCallback() override
+		{
+			for (auto s = 0; s < NumStages; ++s)
+				for (auto b = 0; b < NumBins; ++b)
+				{
+					const auto count = profiler.getCount(static_cast<Stage>(s), b);
+					window[s][b] = count - counts[s][b];
+					counts[s][b] = count;
+				}
+			repaint();
+		}
+
+		void mouseUp(const Mouse&) override
+		{
+			setVisible(false);
+		}
+
+		void paint(Graphics& g) override
+		{
+			g.fillAll(Colours::c(ColourID::Bg).withAlpha(.9f));
+
+			const auto thicc = utils.thicc;
+			const auto bounds = getLocalBounds().toFloat().reduced(thicc * 4.f);
+			const auto rowHeight = bounds.getHeight() / static_cast<float>(NumStages + 1);
+			const auto textWidth = bounds.getWidth() * .4f;
+			const auto barsX = bounds.getX() + textWidth;
+			const auto barWidth = (bounds.getWidth() - textWidth) / static_cast<float>(NumBins);
+
+			g.setFont(getFontDosisMedium());
+			g.setColour(Colours::c(ColourID::Hover));
+			g.drawFittedText("stage: mean / p99 of the block's duration",
+				BoundsF(bounds.getX(), bounds.getY(), textWidth, rowHeight).toNearestInt(), Just::centredLeft, 1);
+			for (auto b = 0; b < NumBins; ++b)
+			{
+				const auto txt = b < NumBins - 1 ? String(Profiler::BinEdges[b]) : String(">");
+				g.drawFittedText(txt, BoundsF(barsX + barWidth * static_cast<float>(b), bounds.getY(), barWidth, rowHeight).toNearestInt(), Just::centred, 1);
+			}
+
+			for (auto s = 0; s < NumStages; ++s)
+			{
+				const auto stage = static_cast<Stage>(s);
+				const auto& hist = window[s];
+				const auto y = bounds.getY() + rowHeight * static_cast<float>(s + 1);
+
+				auto total = 0;
+				for (auto c : hist)
+					total += c;
+				auto p99Bin = NumBins - 1;
+				for (auto b = 0, sum = 0; b < NumBins; ++b)
+				{
+					sum += hist[b];
+					if (total != 0 && sum * 100 >= total * 99)
+					{
+						p99Bin = b;
+						break;
+					}
+				}
+				const auto p99 = p99Bin < NumBins - 1 ? "<" + String(Profiler::BinEdges[p99Bin]) : String(">100");
+
+				g.setColour(Colours::c(ColourID::Txt));
+				g.drawFittedText(String(Profiler::getName(stage)) + ": " + String(profiler.getMean(stage), 2) + "% / " + p99 + "%",
+					BoundsF(bounds.getX(), y, textWidth, rowHeight).toNearestInt(), Just::centredLeft, 1);
+
+				if (total == 0)
+					continue;
+				g.setColour(Colours::c(ColourID::Mod));
+				for (auto b = 0; b < NumBins; ++b)
+				{
+					const auto h = rowHeight * static_cast<float>(hist[b]) / static_cast<float>(total);
+					g.fillRect(barsX + barWidth * static_cast<float>(b) + thicc, y + rowHeight - h, barWidth - thicc * 2.f, h);
+				}
+			}
+		}
+	};
+}
+#endif
\ No newline at end of file
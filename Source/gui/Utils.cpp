@@ -80,6 +80,16 @@ namespace gui
 	{
 		return audioProcessor.meters(i);
 	}
+#if PPDHasProfiler
+	const audio::Profiler& Utils::getProfiler() const noexcept
+	{
+		return audioProcessor.profiler;
+	}
+#endif
+	audio::ModMatrix& Utils::getModMatrix() noexcept
+	{
+		return audioProcessor.modMatrix;
+	}
 
 	Point Utils::getScreenPosition() const noexcept { return pluginTop.getScreenPosition(); }
 
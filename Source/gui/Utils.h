@@ -53,6 +53,10 @@ namespace gui
 		EventSystem& getEventSystem();
 	
 		const std::atomic<float>& getMeter(int i) const noexcept;
+#if PPDHasProfiler
+		const audio::Profiler& getProfiler() const noexcept;
+#endif
+		audio::ModMatrix& getModMatrix() noexcept;
 
 		Point getScreenPosition() const noexcept;
 
@@ -1,4 +1,5 @@
 #include "Param.h"
+#include <map>
 #include "../config.h"
 
 param::String param::toID(const String& name)
@@ -45,20 +46,37 @@ param::String param::toString(PID pID)
 	case PID::Feedback: return "Feedback";
 	case PID::NumVoices: return "Num Voices";
 	case PID::SpreadTune: return "Spread Tune";
+#if PPDHasHQ
+	case PID::HQFactor: return "HQ Factor";
+#endif
 	
 	default: return "Invalid Parameter Name";
 	}
 }
 
+const param::String& param::toID(PID pID)
+{
+	static const auto ids = []()
+	{
+		std::array<String, NumParams> i;
+		for (auto p = 0; p < NumParams; ++p)
+			i[p] = toID(toString(static_cast<PID>(p)));
+		return i;
+	}();
+	return ids[static_cast<int>(pID)];
+}
+
 param::PID param::toPID(const String& id)
 {
-	for (auto i = 0; i < NumParams; ++i)
+	static const auto pIDs = []()
 	{
-		auto pID = static_cast<PID>(i);
-		if (id == toID(toString(pID)))
-			return pID;
-	}
-	return PID::NumParams;
+		std::map<String, PID> m;
+		for (auto p = 0; p < NumParams; ++p)
+			m[toID(static_cast<PID>(p))] = static_cast<PID>(p);
+		return m;
+	}();
+	const auto it = pIDs.find(id);
+	return it != pIDs.end() ? it->second : PID::NumParams;
 }
 
 param::String param::toTooltip(PID pID)
@@ -72,7 +90,7 @@ param::String param::toTooltip(PID pID)
 	case PID::Mix: return "Mix the dry with the wet signal.";
 	case PID::Gain: return "Apply output gain to the wet signal.";
 #if PPDHasHQ
-	case PID::HQ: return "Turn on HQ to apply 2x Oversampling to the signal.";
+	case PID::HQ: return "Turn on HQ to oversample the signal by the HQ factor.";
 #endif
 #if PPDHasPolarity
 	case PID::Polarity: return "Invert the wet signal's polarity.";
@@ -92,6 +110,9 @@ param::String param::toTooltip(PID pID)
 	case PID::Feedback: return "This pitchshifter appears to possess a perculiar kind of feedback.";
 	case PID::NumVoices: return "The number of parallel voices used to pitchshift.";
 	case PID::SpreadTune: return "How spread out the tune values of the voices are.";
+#if PPDHasHQ
+	case PID::HQFactor: return "Choose the oversampling factor of HQ. Higher factors reduce aliasing but cost more CPU.";
+#endif
 	
 	default: return "Invalid Tooltip.";
 	}
@@ -117,6 +138,7 @@ param::String param::toString(Unit pID)
 	case Unit::Polarity: return CharPtr("\xc2\xb0");
 	case Unit::StereoConfig: return "";
 	case Unit::Voices: return "v";
+	case Unit::Oversampling: return "x";
 	default: return "";
 	}
 }
@@ -130,6 +152,10 @@ param::Param::Param(const PID pID, const Range& _range, const float _valDenormDe
 	range(_range),
 
 	state(_state),
+	valuePath(getIDString(), "value"),
+	maxModDepthPath(getIDString(), "maxmoddepth"),
+	modBiasPath(getIDString(), "modbias"),
+	defaultKey(getIDString() + "valDefault"),
 	valDenormDefault(_valDenormDefault),
 
 	valNorm(range.convertTo0to1(_valDenormDefault)),
@@ -142,23 +168,30 @@ param::Param::Param(const PID pID, const Range& _range, const float _valDenormDe
 	unit(_unit),
 
 	locked(_locked),
-	inGesture(false)
+	inGesture(false),
+	defaultChanged(false),
+	changed(nullptr)
 {
 }
 
-void param::Param::savePatch(juce::ApplicationProperties& appProps) const
+void param::Param::savePatch() const
 {
 	const auto v = range.convertFrom0to1(getValue());
-	state.set(getIDString(), "value", v, true);
+	state.set(valuePath, v, false);
 	const auto mdd = getMaxModDepth();
-	state.set(getIDString(), "maxmoddepth", mdd, true);
+	state.set(maxModDepthPath, mdd, false);
 	const auto mb = getModBias();
-	state.set(getIDString(), "modbias", mb, true);
+	state.set(modBiasPath, mb, false);
+}
 
+void param::Param::saveDefault(juce::ApplicationProperties& appProps)
+{
+	if (!defaultChanged.exchange(false))
+		return;
 	auto user = appProps.getUserSettings();
 	if (user->isValidFile())
 	{
-		user->setValue(getIDString() + "valDefault", valDenormDefault);
+		user->setValue(defaultKey, valDenormDefault);
 	}
 }
 
@@ -167,31 +200,45 @@ void param::Param::loadPatch(juce::ApplicationProperties& appProps)
 	const auto lckd = isLocked();
 	if (!lckd)
 	{
-		auto var = state.get(getIDString(), "value");
+		auto var = state.get(valuePath);
 		if (var)
 		{
 			const auto val = static_cast<float>(*var);
 			const auto valD = range.convertTo0to1(val);
 			setValueNotifyingHost(valD);
 		}
-		var = state.get(getIDString(), "maxmoddepth");
+		var = state.get(maxModDepthPath);
 		if (var)
 		{
 			const auto val = static_cast<float>(*var);
 			setMaxModDepth(val);
 		}
-		var = state.get(getIDString(), "modbias");
+		var = state.get(modBiasPath);
 		if (var)
 		{
 			const auto val = static_cast<float>(*var);
 			setModBias(val);
 		}
-		auto user = appProps.getUserSettings();
-		if (user->isValidFile())
-		{
-			const auto vdd = user->getDoubleValue(getIDString() + "valDefault", static_cast<double>(valDenormDefault));
-			setDefaultValue(range.convertTo0to1(static_cast<float>(vdd)));
-		}
+		loadDefault(appProps);
+	}
+}
+
+void param::Param::loadPatch(float valDenorm, float mdd, float mb)
+{
+	if (isLocked())
+		return;
+	setValueNotifyingHost(range.convertTo0to1(valDenorm));
+	setMaxModDepth(mdd);
+	setModBias(mb);
+}
+
+void param::Param::loadDefault(juce::ApplicationProperties& appProps)
+{
+	auto user = appProps.getUserSettings();
+	if (user->isValidFile())
+	{
+		const auto vdd = user->getDoubleValue(defaultKey, static_cast<double>(valDenormDefault));
+		valDenormDefault = range.convertFrom0to1(range.convertTo0to1(static_cast<float>(vdd)));
 	}
 }
 
@@ -203,7 +250,10 @@ float param::Param::getValueDenorm() const noexcept { return range.convertFrom0t
 void param::Param::setValue(float normalized)
 {
 	if (!isLocked())
+	{
 		valNorm.store(normalized);
+		notifyChanged();
+	}
 }
 
 // called by editor
@@ -241,6 +291,7 @@ void param::Param::setMaxModDepth(float v) noexcept
 		return;
 
 	maxModDepth.store(juce::jlimit(-1.f, 1.f, v));
+	notifyChanged();
 }
 
 float param::Param::getValMod() const noexcept { return valMod.load(); }
@@ -254,6 +305,7 @@ void param::Param::setModBias(float b) noexcept
 
 	b = juce::jlimit(BiasEps, 1.f - BiasEps, b);
 	modBias.store(b);
+	notifyChanged();
 }
 
 float param::Param::getModBias() const noexcept { return modBias.load(); }
@@ -261,10 +313,11 @@ float param::Param::getModBias() const noexcept { return modBias.load(); }
 void param::Param::setDefaultValue(float norm) noexcept
 {
 	valDenormDefault = range.convertFrom0to1(norm);
+	defaultChanged.store(true);
 }
 
 // called by processor to update modulation value(s)
-void param::Param::modulate(float macro) noexcept
+float param::Param::modulate(float macro) noexcept
 {
 	const auto norm = getValue();
 
@@ -274,9 +327,13 @@ void param::Param::modulate(float macro) noexcept
 	const auto mdSkew = biased(0.f, md, modBias.load(), macro);
 	const auto mod = mdSkew * pol;
 
-	valMod.store(juce::jlimit(0.f, 1.f, norm + mod));
+	const auto vm = juce::jlimit(0.f, 1.f, norm + mod);
+	valMod.store(vm);
+	return vm;
 }
 
+void param::Param::setChangedFlag(std::atomic<bool>& flag) noexcept { changed = &flag; }
+
 float param::Param::getDefaultValue() const { return range.convertTo0to1(valDenormDefault); }
 
 param::String param::Param::getName(int) const { return toString(id); }
@@ -317,6 +374,12 @@ param::String param::Param::getIDString() const
 	return "params/" + toID(toString(id));
 }
 
+void param::Param::notifyChanged() noexcept
+{
+	if (changed != nullptr)
+		changed->store(true);
+}
+
 float param::Param::biased(float start, float end, float bias/*[0,1]*/, float x) const noexcept
 {
 	const auto r = end - start;
@@ -504,6 +567,16 @@ param::StrToValFunc param::strToVal::voices()
 	};
 }
 
+param::StrToValFunc param::strToVal::oversampling()
+{
+	return[p = parse()](const String& txt)
+	{
+		const auto text = txt.trimCharactersAtEnd(toString(Unit::Oversampling));
+		const auto val = p(text, 2.f);
+		return std::rint(std::log2(val < 1.f ? 1.f : val));
+	};
+}
+
 
 param::ValToStrFunc param::valToStr::mute()
 {
@@ -615,6 +688,14 @@ param::ValToStrFunc param::valToStr::voices()
 	};
 }
 
+param::ValToStrFunc param::valToStr::oversampling()
+{
+	return [](float v)
+	{
+		return String(1 << static_cast<int>(std::rint(v))) + toString(Unit::Oversampling);
+	};
+}
+
 
 param::Param* param::makeParam(PID id, State& state,
 	float valDenormDefault, const Range& range,
@@ -677,6 +758,10 @@ param::Param* param::makeParam(PID id, State& state,
 		valToStrFunc = valToStr::voices();
 		strToValFunc = strToVal::voices();
 		break;
+	case Unit::Oversampling:
+		valToStrFunc = valToStr::oversampling();
+		strToValFunc = strToVal::oversampling();
+		break;
 	default:
 		valToStrFunc = valToStr::empty();
 		strToValFunc = strToVal::percent();
@@ -687,7 +772,17 @@ param::Param* param::makeParam(PID id, State& state,
 }
 
 
+param::Params::Patch::Patch() :
+	valDenorm(),
+	maxModDepth(),
+	modBias(),
+	contained()
+{
+	contained.fill(false);
+}
+
 param::Params::Params(AudioProcessor& audioProcessor, State& state) :
+	changed(true),
 	params()
 {
 	params.push_back(makeParam(PID::Macro, state, 0.f));
@@ -721,8 +816,16 @@ param::Params::Params(AudioProcessor& audioProcessor, State& state) :
 	
 	// LOW LEVEL PARAMS END
 
-	for (auto param : params)
+#if PPDHasHQ
+	params.push_back(makeParam(PID::HQFactor, state, 1.f, makeRange::stepped(1.f, static_cast<float>(PPDOversamplingMaxOrder), 1.f), Unit::Oversampling));
+#endif
+
+	for (auto p = 0; p < params.size(); ++p)
+	{
+		auto param = params[p];
+		param->setChangedFlag(changed);
 		audioProcessor.addParameter(param);
+	}
 }
 
 void param::Params::loadPatch(juce::ApplicationProperties& appProps)
@@ -731,10 +834,73 @@ void param::Params::loadPatch(juce::ApplicationProperties& appProps)
 		param->loadPatch(appProps);
 }
 
-void param::Params::savePatch(juce::ApplicationProperties& appProps) const
+void param::Params::savePatch() const
+{
+	for (auto param : params)
+		param->savePatch();
+}
+
+void param::Params::savePatch(juce::OutputStream& stream) const
+{
+	stream.writeInt(static_cast<int>(params.size()));
+	for (const auto param : params)
+	{
+		/* the id, so the params survive reordering */
+		stream.writeString(toID(param->id));
+		stream.writeFloat(param->getValueDenorm());
+		stream.writeFloat(param->getMaxModDepth());
+		stream.writeFloat(param->getModBias());
+	}
+}
+
+bool param::Params::readPatch(juce::InputStream& stream, Patch& patch)
+{
+	/* an empty id and three floats */
+	static constexpr int MinEntrySize = 1 + 3 * sizeof(float);
+
+	const auto num = stream.readInt();
+	if (num < 0 || num * MinEntrySize > stream.getNumBytesRemaining())
+		return false;
+
+	for (auto i = 0; i < num; ++i)
+	{
+		const auto pID = toPID(stream.readString());
+		const auto valDenorm = stream.readFloat();
+		const auto mdd = stream.readFloat();
+		const auto mb = stream.readFloat();
+		/* the rest of the state comes after the params */
+		if (stream.isExhausted())
+			return false;
+
+		/* params that don't exist anymore are skipped */
+		if (pID == PID::NumParams)
+			continue;
+		const auto p = static_cast<int>(pID);
+		patch.valDenorm[p] = valDenorm;
+		patch.maxModDepth[p] = mdd;
+		patch.modBias[p] = mb;
+		patch.contained[p] = true;
+	}
+	return true;
+}
+
+void param::Params::loadPatch(const Patch& patch)
+{
+	for (auto p = 0; p < params.size(); ++p)
+		if (patch.contained[p])
+			params[p]->loadPatch(patch.valDenorm[p], patch.maxModDepth[p], patch.modBias[p]);
+}
+
+void param::Params::loadDefaults(juce::ApplicationProperties& appProps)
+{
+	for (auto param : params)
+		param->loadDefault(appProps);
+}
+
+void param::Params::saveDefaults(juce::ApplicationProperties& appProps)
 {
 	for (auto param : params)
-		param->savePatch(appProps);
+		param->saveDefault(appProps);
 }
 
 int param::Params::getParamIdx(const String& nameOrID) const
@@ -758,16 +924,42 @@ const param::Param* param::Params::operator[](PID p) const noexcept { return par
 param::Params::Parameters& param::Params::data() noexcept { return params; }
 const param::Params::Parameters& param::Params::data() const noexcept { return params; }
 
+param::Snapshot::Snapshot() :
+	valMod(),
+	valModDenorm()
+{
+	valMod.fill(0.f);
+	valModDenorm.fill(0.f);
+}
+
+float param::Snapshot::getValMod(PID p) const noexcept { return valMod[static_cast<int>(p)]; }
+float param::Snapshot::getValModDenorm(PID p) const noexcept { return valModDenorm[static_cast<int>(p)]; }
+
 param::MacroProcessor::MacroProcessor(Params& _params) :
-	params(_params)
+	params(_params),
+	snapshot()
 {
 }
 
 void param::MacroProcessor::operator()() noexcept
 {
-	const auto modDepth = params[PID::Macro]->getValue();
+	/* a change that comes in while rebuilding sets the flag again */
+	if (!params.changed.exchange(false))
+		return;
+
+	const auto macro = params[PID::Macro];
+	const auto modDepth = macro->getValue();
+	snapshot.valMod[0] = modDepth;
+	snapshot.valModDenorm[0] = macro->range.convertFrom0to1(modDepth);
 	for (auto i = 1; i < NumParams; ++i)
-		params[i]->modulate(modDepth);
+	{
+		const auto param = params[i];
+		const auto vm = param->modulate(modDepth);
+		snapshot.valMod[i] = vm;
+		snapshot.valModDenorm[i] = param->range.convertFrom0to1(vm);
+	}
 }
 
+const param::Snapshot& param::MacroProcessor::getSnapshot() const noexcept { return snapshot; }
+
 #include "../configEnd.h"
\ No newline at end of file
@@ -50,17 +50,25 @@ namespace param
 		NumVoices,
 		SpreadTune,
 
+		// hosts know the params by their index, so new ones go last
+#if PPDHasHQ
+		HQFactor,
+#endif
+
 		NumParams
 	};
 
 	static constexpr int NumParams = static_cast<int>(PID::NumParams);
 	static constexpr int MinLowLevelIdx = static_cast<int>(PID::Power) + 1;
-	static constexpr int NumLowLevelParams = NumParams - MinLowLevelIdx;
+	static constexpr int NumLowLevelParams = static_cast<int>(PID::SpreadTune) + 1 - MinLowLevelIdx;
 
 	PID ll(PID, int/*offset*/) noexcept;
 
 	String toString(PID);
 
+	/* the id of each param only gets built once */
+	const String& toID(PID);
+
 	PID toPID(const String&);
 
 	String toTooltip(PID);
@@ -83,6 +91,7 @@ namespace param
 		Polarity,
 		StereoConfig,
 		Voices,
+		Oversampling,
 		NumUnits
 	};
 
@@ -107,10 +116,19 @@ namespace param
 			const ValToStrFunc&, const StrToValFunc&,
 			State&, const Unit = Unit::NumUnits, bool/*_locked*/ = false);
 
-		void savePatch(juce::ApplicationProperties&) const;
+		/* never undoable, so saving a patch doesn't grow the undo history */
+		void savePatch() const;
 
 		void loadPatch(juce::ApplicationProperties&);
 
+		/* applies the values of a binary patch */
+		void loadPatch(float/*valDenorm*/, float/*maxModDepth*/, float/*modBias*/);
+
+		/* the default value is per user, not per patch. only written if it changed */
+		void saveDefault(juce::ApplicationProperties&);
+
+		void loadDefault(juce::ApplicationProperties&);
+
 		//called by host, normalized, thread-safe
 		float getValue() const override;
 
@@ -142,8 +160,11 @@ namespace param
 
 		void setDefaultValue(float/*norm*/) noexcept;
 
-		// called by processor to update modulation value(s)
-		void modulate(float/*macro*/) noexcept;
+		// called by processor to update modulation value(s). returns the new valMod
+		float modulate(float/*macro*/) noexcept;
+
+		// gets set whenever something changes that affects valMod
+		void setChangedFlag(std::atomic<bool>&) noexcept;
 
 		float getDefaultValue() const override;
 
@@ -171,16 +192,21 @@ namespace param
 		const Range range;
 	protected:
 		State& state;
+		const State::Path valuePath, maxModDepthPath, modBiasPath;
+		const String defaultKey;
 		float valDenormDefault;
 		std::atomic<float> valNorm, maxModDepth, valMod, modBias;
 		ValToStrFunc valToStr;
 		StrToValFunc strToVal;
 		Unit unit;
 
-		std::atomic<bool> locked, inGesture;
+		std::atomic<bool> locked, inGesture, defaultChanged;
+		std::atomic<bool>* changed;
 	private:
 		String getIDString() const;
 
+		void notifyChanged() noexcept;
+
 		float biased(float /*start*/, float /*end*/, float /*bias [0,1]*/, float /*x*/) const noexcept;
 	};
 
@@ -205,6 +231,7 @@ namespace param
 		StrToValFunc ms();
 		StrToValFunc db();
 		StrToValFunc voices();
+		StrToValFunc oversampling();
 	}
 
 	namespace valToStr
@@ -228,6 +255,7 @@ namespace param
 		ValToStrFunc db();
 		ValToStrFunc empty();
 		ValToStrFunc voices();
+		ValToStrFunc oversampling();
 	}
 
 	Param* makeParam(PID, State&,
@@ -239,11 +267,33 @@ namespace param
 		using AudioProcessor = juce::AudioProcessor;
 		using Parameters = std::vector<Param*>;
 
+		/* the values of a binary patch, before they get applied */
+		struct Patch
+		{
+			Patch();
+
+			std::array<float, NumParams> valDenorm, maxModDepth, modBias;
+			std::array<bool, NumParams> contained;
+		};
+
 		Params(AudioProcessor&, State&);
 
 		void loadPatch(juce::ApplicationProperties&);
 
-		void savePatch(juce::ApplicationProperties&) const;
+		void savePatch() const;
+
+		/* writes each param's id and values */
+		void savePatch(juce::OutputStream&) const;
+
+		/* only reads. returns false if the data is broken */
+		static bool readPatch(juce::InputStream&, Patch&);
+
+		void loadPatch(const Patch&);
+
+		void loadDefaults(juce::ApplicationProperties&);
+
+		/* call from the message thread */
+		void saveDefaults(juce::ApplicationProperties&);
 
 		int getParamIdx(const String& /*nameOrID*/) const;
 
@@ -256,17 +306,36 @@ namespace param
 
 		Parameters& data() noexcept;
 		const Parameters& data() const noexcept;
+
+		/* true if any parameter changed since the macro processor looked */
+		std::atomic<bool> changed;
 	protected:
 		Parameters params;
 	};
 
+	/* the macro-modulated values of all parameters at the start of a block */
+	struct Snapshot
+	{
+		Snapshot();
+
+		float getValMod(PID) const noexcept;
+		float getValModDenorm(PID) const noexcept;
+
+		std::array<float, NumParams> valMod, valModDenorm;
+	};
+
 	struct MacroProcessor
 	{
 		MacroProcessor(Params&);
 
+		/* rebuilds the snapshot, if any parameter changed since the last call */
 		void operator()() noexcept;
 
+		const Snapshot& getSnapshot() const noexcept;
+
 		Params& params;
+	protected:
+		Snapshot snapshot;
 	};
 }
 
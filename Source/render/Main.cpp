@@ -0,0 +1,251 @@
+#include "../Processor.h"
+
+#if JUCE_WINDOWS
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+#include <algorithm>
+#include <iostream>
+
+/*
+renders an audio file through the processor without a host.
+
+usage:
+	PitchGlitcherRender --in <file> --out <file>
+		[--patch <state.xml> | --state <binary state>]
+		[--block <samples>] [--automation <file>] [--no-latency-compensation]
+
+the output format follows the extension of the output file (wav, aiff, flac).
+the automation file has one change per line: <sample> <param name or id> <value>.
+the values are in the parameter's own units, like 120 for a grain size of 120ms.
+reports the real-time factor, per-block processing time and peak memory.
+*/
+
+namespace render
+{
+	using String = juce::String;
+	using File = juce::File;
+	using ArgumentList = juce::ArgumentList;
+	using AudioBuffer = juce::AudioBuffer<float>;
+	using Ticks = juce::int64;
+	using Events = std::vector<audio::Automation::Event>;
+
+	static constexpr int DefaultBlockSize = 512;
+
+	inline double getPeakMemoryMB() noexcept
+	{
+#if JUCE_WINDOWS
+		PROCESS_MEMORY_COUNTERS pmc;
+		if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+			return static_cast<double>(pmc.PeakWorkingSetSize) / (1024. * 1024.);
+		return 0.;
+#else
+		rusage usage;
+		if (getrusage(RUSAGE_SELF, &usage) != 0)
+			return 0.;
+#if JUCE_MAC
+		return static_cast<double>(usage.ru_maxrss) / (1024. * 1024.);
+#else
+		return static_cast<double>(usage.ru_maxrss) / 1024.;
+#endif
+#endif
+	}
+
+	/* value at the given percentile [0,1] of unsorted data. reorders data */
+	inline double getPercentile(std::vector<double>& data, double p) noexcept
+	{
+		if (data.empty())
+			return 0.;
+		const auto idx = static_cast<size_t>(p * static_cast<double>(data.size() - 1) + .5);
+		std::nth_element(data.begin(), data.begin() + idx, data.end());
+		return data[idx];
+	}
+
+	inline int fail(const String& msg)
+	{
+		std::cerr << msg << std::endl;
+		return 1;
+	}
+
+	inline bool loadState(audio::Processor& processor, const ArgumentList& args)
+	{
+		if (args.containsOption("--patch"))
+		{
+			const auto file = args.getExistingFileForOption("--patch");
+			processor.state.loadPatch(file);
+			processor.loadPatch();
+			return true;
+		}
+		if (args.containsOption("--state"))
+		{
+			const auto file = args.getExistingFileForOption("--state");
+			juce::MemoryBlock data;
+			if (!file.loadFileAsData(data))
+				return false;
+			processor.setStateInformation(data.getData(), static_cast<int>(data.getSize()));
+			return true;
+		}
+		return true;
+	}
+
+	inline bool loadAutomation(const audio::Processor& processor, const File& file, Events& events)
+	{
+		juce::StringArray lines;
+		file.readLines(lines);
+		for (const auto& line : lines)
+		{
+			const auto tokens = juce::StringArray::fromTokens(line.trim(), true);
+			if (tokens.isEmpty() || tokens[0].startsWith("#"))
+				continue;
+			if (tokens.size() != 3)
+				return false;
+
+			const auto paramIdx = processor.params.getParamIdx(tokens[1]);
+			if (paramIdx < 0)
+				return false;
+			const auto& range = processor.params[paramIdx]->range;
+			const auto valDenorm = juce::jlimit(range.start, range.end, tokens[2].getFloatValue());
+			events.push_back({ tokens[0].getLargeIntValue(), paramIdx, range.convertTo0to1(valDenorm) });
+		}
+		std::stable_sort(events.begin(), events.end(), [](const auto& a, const auto& b)
+		{
+			return a.time < b.time;
+		});
+		return true;
+	}
+
+	inline int run(const ArgumentList& args)
+	{
+		if (!args.containsOption("--in") || !args.containsOption("--out"))
+			return fail("usage: --in <file> --out <file> [--patch <xml> | --state <bin>] [--block <samples>] [--automation <file>] [--no-latency-compensation]");
+
+		const auto inFile = args.getExistingFileForOption("--in");
+		const auto outFile = args.getFileForOption("--out");
+		const auto blockSize = args.containsOption("--block") ?
+			args.getValueForOption("--block").getIntValue() :
+			DefaultBlockSize;
+		const auto compensateLatency = !args.containsOption("--no-latency-compensation");
+		if (blockSize < 1)
+			return fail("block size must be positive");
+
+		juce::AudioFormatManager formats;
+		formats.registerBasicFormats();
+
+		std::unique_ptr<juce::AudioFormatReader> reader(formats.createReaderFor(inFile));
+		if (reader == nullptr)
+			return fail("can't read " + inFile.getFullPathName());
+
+		const auto numChannels = static_cast<int>(reader->numChannels);
+		if (numChannels != 1 && numChannels != 2)
+			return fail("only mono and stereo files are supported");
+		const auto sampleRate = reader->sampleRate;
+		const auto lengthIn = reader->lengthInSamples;
+
+		auto format = formats.findFormatForFileExtension(outFile.getFileExtension());
+		if (format == nullptr)
+			return fail("unknown output format " + outFile.getFileExtension());
+		outFile.deleteFile();
+		std::unique_ptr<juce::OutputStream> stream(outFile.createOutputStream());
+		if (stream == nullptr)
+			return fail("can't write " + outFile.getFullPathName());
+		const auto bitDepth = static_cast<int>(juce::jmin(24u, reader->bitsPerSample));
+		std::unique_ptr<juce::AudioFormatWriter> writer(format->createWriterFor(
+			stream.get(), sampleRate, static_cast<unsigned int>(numChannels), bitDepth, {}, 0
+		));
+		if (writer == nullptr)
+			return fail("can't create a writer for " + outFile.getFullPathName());
+		stream.release();
+
+		audio::Processor processor;
+		if (!loadState(processor, args))
+			return fail("can't load the state");
+
+		Events events;
+		if (args.containsOption("--automation"))
+			if (!loadAutomation(processor, args.getExistingFileForOption("--automation"), events))
+				return fail("can't parse the automation");
+		auto nextEvent = events.cbegin();
+
+		processor.setPlayConfigDetails(numChannels, numChannels, sampleRate, blockSize);
+		processor.prepareToPlay(sampleRate, blockSize);
+		processor.setNonRealtime(true);
+
+		const auto latency = compensateLatency ? processor.getLatencySamples() : 0;
+		const auto lengthOut = lengthIn + latency;
+		const auto numBlocks = static_cast<size_t>((lengthOut + blockSize - 1) / blockSize);
+
+		AudioBuffer buffer(numChannels, blockSize);
+		juce::MidiBuffer midi;
+		std::vector<double> blockTimes;
+		blockTimes.reserve(numBlocks);
+
+		Ticks ticksTotal = 0;
+		juce::int64 posIn = 0, posOut = 0;
+		auto skip = static_cast<juce::int64>(latency);
+		while (posOut < lengthIn)
+		{
+			const auto numSamples = static_cast<int>(juce::jmin(static_cast<juce::int64>(blockSize), lengthOut - posIn));
+			buffer.setSize(numChannels, numSamples, false, false, true);
+			/* reads zeros past the end of the file */
+			reader->read(&buffer, 0, numSamples, posIn, true, true);
+			midi.clear();
+
+			/* everything that starts in this block. the rest waits for the next one if the queue is full */
+			while (nextEvent != events.cend() && nextEvent->time < posIn + numSamples
+				&& processor.automation.push(*nextEvent))
+				++nextEvent;
+
+			const auto t0 = juce::Time::getHighResolutionTicks();
+			processor.processBlock(buffer, midi);
+			const auto t1 = juce::Time::getHighResolutionTicks();
+			ticksTotal += t1 - t0;
+			blockTimes.push_back(juce::Time::highResolutionTicksToSeconds(t1 - t0));
+			posIn += numSamples;
+			/* there is no message loop, so hq changes get prepared between the blocks */
+			processor.timerCallback();
+
+			const auto start = static_cast<int>(juce::jmin(skip, static_cast<juce::int64>(numSamples)));
+			skip -= start;
+			const auto numOut = static_cast<int>(juce::jmin(static_cast<juce::int64>(numSamples - start), lengthIn - posOut));
+			if (numOut > 0)
+			{
+				writer->writeFromAudioSampleBuffer(buffer, start, numOut);
+				posOut += numOut;
+			}
+		}
+		processor.releaseResources();
+
+		const auto secondsProcessed = juce::Time::highResolutionTicksToSeconds(ticksTotal);
+		const auto secondsAudio = static_cast<double>(posIn) / sampleRate;
+		const auto rtf = secondsProcessed > 0. ? secondsAudio / secondsProcessed : 0.;
+		const auto blockMs = 1000. * static_cast<double>(blockSize) / sampleRate;
+		const auto p50 = getPercentile(blockTimes, .5) * 1000.;
+		const auto p99 = getPercentile(blockTimes, .99) * 1000.;
+
+		std::cout
+			<< "file:        " << inFile.getFileName() << "\n"
+			<< "sample rate: " << sampleRate << " Hz, block: " << blockSize << " (" << blockMs << " ms)\n"
+			<< "latency:     " << processor.getLatencySamples() << " samples" << (compensateLatency ? " (compensated)" : "") << "\n"
+			<< "blocks:      " << blockTimes.size() << "\n"
+			<< "realtime:    " << rtf << "x\n"
+			<< "block p50:   " << p50 << " ms\n"
+			<< "block p99:   " << p99 << " ms\n"
+			<< "peak memory: " << getPeakMemoryMB() << " MB" << std::endl;
+
+		return 0;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const juce::ScopedJuceInitialiser_GUI juceInit;
+	const juce::ArgumentList args(argc, argv);
+	return juce::ConsoleApplication::invokeCatchingFailures([&args]()
+	{
+		return render::run(args);
+	});
+}
\ No newline at end of file